@@ -0,0 +1,487 @@
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+// Headless end-to-end benchmark: runs the editor on a pty, replays keystroke
+// traces against generated files and prints one JSON object per run.
+//
+// Every editorRefreshScreen() ends with "\x1b[?25h", so that sequence is used
+// as the frame terminator. Every key the editor reads produces exactly one
+// frame, which is how a trace step knows when the editor caught up.
+
+#define BENCH_FRAME_END "\x1b[?25h"
+#define BENCH_FRAME_END_LEN 6
+#define BENCH_TIMEOUT_MS 60000
+#define BENCH_MAX_STEPS 256
+
+typedef struct benchStep {
+    char *keys;
+    int len;
+    int repeat;
+    int paste; // write every repeat at once instead of one key per frame
+} benchStep;
+
+typedef struct benchTrace {
+    char name[64];
+    benchStep steps[BENCH_MAX_STEPS];
+    int nsteps;
+} benchTrace;
+
+typedef struct benchRun {
+    pid_t pid;
+    int master;
+    int match; // bytes of BENCH_FRAME_END matched so far
+    long frames;
+    long long bytes;
+    long long frame_bytes;
+    double *lat;
+    long nlat;
+    long latcap;
+    long long *fbytes;
+    long nfbytes;
+    long fbytescap;
+} benchRun;
+
+static char *editor_path = "./text_editor";
+static int win_rows = 40;
+static int win_cols = 120;
+
+static double nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static void fail(const char *what) {
+    perror(what);
+    exit(1);
+}
+
+// TRACE FILES
+
+static int keyByName(const char *name, char *out) {
+    static const struct {
+        const char *name;
+        const char *seq;
+    } keys[] = {{"UP", "\x1b[A"},      {"DOWN", "\x1b[B"},
+                {"RIGHT", "\x1b[C"},   {"LEFT", "\x1b[D"},
+                {"HOME", "\x1b[H"},    {"END", "\x1b[F"},
+                {"PGUP", "\x1b[5~"},   {"PGDN", "\x1b[6~"},
+                {"DEL", "\x1b[3~"},    {"ENTER", "\r"},
+                {"ESC", "\x1b"},       {"BS", "\x7f"},
+                {"TAB", "\t"},         {"SPACE", " "}};
+    for (unsigned int i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        if (!strcmp(name, keys[i].name)) {
+            strcpy(out, keys[i].seq);
+            return strlen(out);
+        }
+    }
+    if (!strncmp(name, "CTRL-", 5) && name[5] && !name[6]) {
+        out[0] = name[5] & 0x1f;
+        return 1;
+    }
+    return -1;
+}
+
+// Trace syntax, one step per line:
+//   key NAME [COUNT]     send a named key (UP, PGDN, CTRL-F, ...) COUNT times
+//   type TEXT            send TEXT one key at a time
+//   paste TEXT [COUNT]   write TEXT COUNT times in a single burst
+static int loadTrace(const char *path, benchTrace *trace) {
+    FILE *fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    snprintf(trace->name, sizeof(trace->name), "%s", base);
+    char *dot = strrchr(trace->name, '.');
+    if (dot)
+        *dot = '\0';
+    trace->nsteps = 0;
+
+    char *line = NULL;
+    size_t linecap = 0;
+    ssize_t linelen;
+    int lineno = 0;
+    while ((linelen = getline(&line, &linecap, fp)) != -1) {
+        lineno++;
+        while (linelen > 0 &&
+               (line[linelen - 1] == '\n' || line[linelen - 1] == '\r'))
+            line[--linelen] = '\0';
+        if (linelen == 0 || line[0] == '#')
+            continue;
+        if (trace->nsteps == BENCH_MAX_STEPS) {
+            fprintf(stderr, "%s:%d: too many steps\n", path, lineno);
+            break;
+        }
+        benchStep *s = &trace->steps[trace->nsteps];
+        s->repeat = 1;
+        s->paste = 0;
+        char *arg = strchr(line, ' ');
+        if (arg)
+            *arg++ = '\0';
+        if (!strcmp(line, "key") && arg) {
+            char name[32], seq[16];
+            if (sscanf(arg, "%31s %d", name, &s->repeat) < 1 ||
+                (s->len = keyByName(name, seq)) < 0) {
+                fprintf(stderr, "%s:%d: bad key '%s'\n", path, lineno, arg);
+                continue;
+            }
+            s->keys = malloc(s->len);
+            memcpy(s->keys, seq, s->len);
+        } else if ((!strcmp(line, "type") || !strcmp(line, "paste")) && arg) {
+            s->paste = line[0] == 'p';
+            char *count = strrchr(arg, ' ');
+            if (s->paste && count && atoi(count + 1) > 0) {
+                s->repeat = atoi(count + 1);
+                *count = '\0';
+            }
+            s->keys = strdup(arg);
+            s->len = strlen(arg);
+        } else {
+            fprintf(stderr, "%s:%d: unknown step '%s'\n", path, lineno, line);
+            continue;
+        }
+        if (s->repeat < 1)
+            s->repeat = 1;
+        trace->nsteps++;
+    }
+    free(line);
+    fclose(fp);
+    return 0;
+}
+
+// Number of keys (and therefore frames) a chunk of input stands for.
+static int countKeys(const char *keys, int len) {
+    int n = 0;
+    for (int i = 0; i < len; i++) {
+        n++;
+        if (keys[i] == '\x1b' && i + 2 < len && (keys[i + 1] == '[' ||
+                                                 keys[i + 1] == 'O')) {
+            i += 2;
+            if (keys[i] >= '0' && keys[i] <= '9' && i + 1 < len)
+                i++;
+        }
+    }
+    return n;
+}
+
+// INPUT FILES
+
+// Deterministic C-ish text: keywords, numbers, strings, tabs and closed
+// comments so the highlighter does real work on every row.
+static char *generateFile(const char *dir, long lines) {
+    static const char *templates[] = {
+        "int %s_%ld = %ld;",
+        "\tif (%s[%ld] == '\\n') return %ld; // branch",
+        "\t\tfor (long i = 0; i < 10; i++) %s(%ld, %ld);",
+        "/* %s block %ld spans %ld */",
+        "\tchar *%s = \"value %ld with\\ttab %ld\";",
+        "static double %s_%ld(void) { return %ld.5; }",
+        "",
+        "\t\t\twhile (%s--) { continue; } /* %ld %ld */",
+    };
+    static const char *names[] = {"alpha", "buffer", "cursor", "render",
+                                  "offset", "syntax", "window", "row"};
+    char *path = malloc(strlen(dir) + 64);
+    sprintf(path, "%s/bench_%ld.c", dir, lines);
+    FILE *fp = fopen(path, "w");
+    if (!fp)
+        fail("fopen");
+    unsigned long seed = 2166136261u;
+    for (long i = 0; i < lines; i++) {
+        seed = seed * 1103515245u + 12345u;
+        const char *t = templates[(seed >> 16) % 8];
+        const char *n = names[(seed >> 8) % 8];
+        fprintf(fp, t, n, i, (long)(seed % 1000));
+        fputc('\n', fp);
+    }
+    fclose(fp);
+    return path;
+}
+
+static void copyFile(const char *from, const char *to) {
+    int in = open(from, O_RDONLY);
+    int out = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (in == -1 || out == -1)
+        fail("open");
+    char buf[1 << 16];
+    ssize_t n;
+    while ((n = read(in, buf, sizeof(buf))) > 0)
+        if (write(out, buf, n) != n)
+            fail("write");
+    close(in);
+    close(out);
+}
+
+// EDITOR PROCESS
+
+static void pushLatency(benchRun *r, double ms) {
+    if (r->nlat == r->latcap) {
+        r->latcap = r->latcap ? r->latcap * 2 : 1024;
+        r->lat = realloc(r->lat, sizeof(double) * r->latcap);
+    }
+    r->lat[r->nlat++] = ms;
+}
+
+static void pushFrameBytes(benchRun *r, long long bytes) {
+    if (r->nfbytes == r->fbytescap) {
+        r->fbytescap = r->fbytescap ? r->fbytescap * 2 : 1024;
+        r->fbytes = realloc(r->fbytes, sizeof(long long) * r->fbytescap);
+    }
+    r->fbytes[r->nfbytes++] = bytes;
+}
+
+// Drains editor output and returns the number of complete frames seen.
+static int readFrames(benchRun *r) {
+    char buf[1 << 16];
+    int frames = 0;
+    ssize_t n;
+    while ((n = read(r->master, buf, sizeof(buf))) > 0) {
+        r->bytes += n;
+        for (ssize_t i = 0; i < n; i++) {
+            r->frame_bytes++;
+            if (buf[i] == BENCH_FRAME_END[r->match]) {
+                if (++r->match == BENCH_FRAME_END_LEN) {
+                    r->match = 0;
+                    r->frames++;
+                    frames++;
+                    pushFrameBytes(r, r->frame_bytes);
+                    r->frame_bytes = 0;
+                }
+            } else {
+                r->match = (buf[i] == BENCH_FRAME_END[0]);
+            }
+        }
+    }
+    if (n == -1 && errno != EAGAIN && errno != EIO)
+        fail("read");
+    return frames;
+}
+
+// Writes `len` bytes and waits for `expect` frames, recording the latency of
+// each one relative to the previous frame (or to the write for the first).
+static int sendAndWait(benchRun *r, const char *keys, int len, int expect) {
+    int written = 0;
+    double start = nowMs();
+    double last = start;
+    while (expect > 0) {
+        struct pollfd pfd = {r->master, POLLIN, 0};
+        if (written < len)
+            pfd.events |= POLLOUT;
+        int ready = poll(&pfd, 1, BENCH_TIMEOUT_MS);
+        if (ready == -1 && errno != EINTR)
+            fail("poll");
+        if (ready == 0) {
+            fprintf(stderr, "e2e: timed out waiting for a frame\n");
+            return -1;
+        }
+        if ((pfd.revents & POLLOUT) && written < len) {
+            ssize_t n = write(r->master, keys + written, len - written);
+            if (n > 0)
+                written += n;
+        }
+        if (pfd.revents & (POLLIN | POLLHUP)) {
+            int frames = readFrames(r);
+            double now = nowMs();
+            for (int i = 0; i < frames && expect > 0; i++, expect--)
+                pushLatency(r, (now - last) / frames);
+            if (frames)
+                last = now;
+            if ((pfd.revents & POLLHUP) && !frames)
+                return -1;
+        }
+    }
+    return 0;
+}
+
+static int startEditor(benchRun *r, const char *file) {
+    struct winsize ws = {0};
+    ws.ws_row = win_rows;
+    ws.ws_col = win_cols;
+    r->pid = forkpty(&r->master, NULL, NULL, &ws);
+    if (r->pid == -1)
+        fail("forkpty");
+    if (r->pid == 0) {
+        execl(editor_path, editor_path, file, (char *)NULL);
+        perror("execl");
+        _exit(127);
+    }
+    fcntl(r->master, F_SETFL, fcntl(r->master, F_GETFL) | O_NONBLOCK);
+    return 0;
+}
+
+static long stopEditor(benchRun *r) {
+    struct rusage ru;
+    int status;
+    for (int i = 0; i < 8; i++) {
+        char quit = 0x11; // Ctrl-Q, repeated past the unsaved-changes warning
+        write(r->master, &quit, 1);
+        usleep(20000);
+        readFrames(r);
+        if (wait4(r->pid, &status, WNOHANG, &ru) == r->pid)
+            goto done;
+    }
+    kill(r->pid, SIGKILL);
+    wait4(r->pid, &status, 0, &ru);
+done:
+    while (readFrames(r) > 0)
+        ;
+    close(r->master);
+    return ru.ru_maxrss;
+}
+
+// REPORTING
+
+static int cmpDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static int cmpLL(const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+static double pct(double *v, long n, double p) {
+    if (n == 0)
+        return 0;
+    long i = (long)(p / 100.0 * (n - 1) + 0.5);
+    return v[i];
+}
+
+static void runTrace(const char *dir, const char *file, long lines,
+                     benchTrace *trace) {
+    char work[4096];
+    snprintf(work, sizeof(work), "%s/%s_%ld.c", dir, trace->name, lines);
+    copyFile(file, work);
+    struct stat st;
+    stat(work, &st);
+
+    benchRun r;
+    memset(&r, 0, sizeof(r));
+    double t0 = nowMs();
+    startEditor(&r, work);
+    int ok = sendAndWait(&r, NULL, 0, 1) == 0;
+    double open_ms = nowMs() - t0;
+    r.nlat = 0; // the first frame is reported as open_ms
+    r.nfbytes = 0;
+
+    for (int i = 0; ok && i < trace->nsteps; i++) {
+        benchStep *s = &trace->steps[i];
+        if (s->paste) {
+            int len = s->len * s->repeat;
+            char *burst = malloc(len);
+            for (int k = 0; k < s->repeat; k++)
+                memcpy(burst + k * s->len, s->keys, s->len);
+            ok = sendAndWait(&r, burst, len, countKeys(burst, len)) == 0;
+            free(burst);
+        } else if (countKeys(s->keys, s->len) == 1) {
+            for (int k = 0; ok && k < s->repeat; k++)
+                ok = sendAndWait(&r, s->keys, s->len, 1) == 0;
+        } else {
+            for (int k = 0; ok && k < s->repeat; k++)
+                for (int j = 0; ok && j < s->len; j++)
+                    ok = sendAndWait(&r, &s->keys[j], 1, 1) == 0;
+        }
+    }
+    long rss = stopEditor(&r);
+
+    qsort(r.lat, r.nlat, sizeof(double), cmpDouble);
+    qsort(r.fbytes, r.nfbytes, sizeof(long long), cmpLL);
+    double total = 0;
+    for (long i = 0; i < r.nlat; i++)
+        total += r.lat[i];
+    long long fb50 = r.nfbytes ? r.fbytes[r.nfbytes / 2] : 0;
+    long long fbmax = r.nfbytes ? r.fbytes[r.nfbytes - 1] : 0;
+
+    printf("{\"bench\":\"e2e\",\"trace\":\"%s\",\"lines\":%ld,"
+           "\"file_bytes\":%lld,\"ok\":%s,\"open_ms\":%.3f,\"frames\":%ld,"
+           "\"frame_ms\":{\"mean\":%.4f,\"p50\":%.4f,\"p90\":%.4f,"
+           "\"p99\":%.4f,\"max\":%.4f},\"bytes_written\":%lld,"
+           "\"frame_bytes\":{\"p50\":%lld,\"max\":%lld},"
+           "\"peak_rss_kb\":%ld}\n",
+           trace->name, lines, (long long)st.st_size, ok ? "true" : "false",
+           open_ms, r.nlat, r.nlat ? total / r.nlat : 0.0,
+           pct(r.lat, r.nlat, 50), pct(r.lat, r.nlat, 90),
+           pct(r.lat, r.nlat, 99), r.nlat ? r.lat[r.nlat - 1] : 0.0, r.bytes,
+           fb50, fbmax, rss);
+    fflush(stdout);
+    free(r.lat);
+    free(r.fbytes);
+    unlink(work);
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [-e editor] [-l lines,lines,...] [-w COLSxROWS] "
+            "trace...\n",
+            argv0);
+    exit(2);
+}
+
+int main(int argc, char *argv[]) {
+    char *sizes = "1000,10000,100000";
+    int opt;
+    while ((opt = getopt(argc, argv, "e:l:w:")) != -1) {
+        switch (opt) {
+        case 'e':
+            editor_path = optarg;
+            break;
+        case 'l':
+            sizes = optarg;
+            break;
+        case 'w':
+            if (sscanf(optarg, "%dx%d", &win_cols, &win_rows) != 2)
+                usage(argv[0]);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (optind == argc)
+        usage(argv[0]);
+
+    int ntraces = argc - optind;
+    benchTrace *traces = calloc(ntraces, sizeof(benchTrace));
+    for (int i = 0; i < ntraces; i++)
+        if (loadTrace(argv[optind + i], &traces[i]) == -1)
+            fail(argv[optind + i]);
+
+    char dir[] = "/tmp/kilo-bench-XXXXXX";
+    if (!mkdtemp(dir))
+        fail("mkdtemp");
+    signal(SIGPIPE, SIG_IGN);
+
+    char *list = strdup(sizes);
+    for (char *tok = strtok(list, ","); tok; tok = strtok(NULL, ",")) {
+        long lines = atol(tok);
+        if (lines <= 0)
+            continue;
+        char *file = generateFile(dir, lines);
+        for (int i = 0; i < ntraces; i++)
+            runTrace(dir, file, lines, &traces[i]);
+        unlink(file);
+        free(file);
+    }
+    free(list);
+    rmdir(dir);
+    return 0;
+}
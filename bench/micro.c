@@ -0,0 +1,243 @@
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bracket.h"
+#include "complete.h"
+#include "editor.h"
+#include "load.h"
+#include "replace.h"
+
+// Microbenchmarks for the editor core. Each workload fills E with synthetic
+// rows, then every hot primitive is timed on it. Output is one JSON object
+// per (workload, function) pair, in the same style as bench/e2e.
+
+typedef struct benchLines {
+    char **line;
+    size_t *len;
+    int n;
+} benchLines;
+
+typedef struct benchWorkload {
+    const char *name;
+    void (*generate)(benchLines *lines, int scale);
+} benchWorkload;
+
+static double nowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static void report(const char *workload, const char *fn, long ops,
+                   double ms) {
+    printf("{\"bench\":\"micro\",\"workload\":\"%s\",\"fn\":\"%s\","
+           "\"ops\":%ld,\"total_ms\":%.3f,\"ns_per_op\":%.1f}\n",
+           workload, fn, ops, ms, ops ? ms * 1e6 / ops : 0.0);
+    fflush(stdout);
+}
+
+static void pushLine(benchLines *lines, const char *s, size_t len) {
+    lines->line = realloc(lines->line, sizeof(char *) * (lines->n + 1));
+    lines->len = realloc(lines->len, sizeof(size_t) * (lines->n + 1));
+    lines->line[lines->n] = malloc(len + 1);
+    memcpy(lines->line[lines->n], s, len);
+    lines->line[lines->n][len] = '\0';
+    lines->len[lines->n] = len;
+    lines->n++;
+}
+
+// WORKLOADS
+
+static void genLongLines(benchLines *lines, int scale) {
+    const char *chunk = "if (value == 42) { name = \"str\"; } /* c */ ";
+    size_t clen = strlen(chunk);
+    size_t len = 64 * 1024;
+    char *buf = malloc(len);
+    for (size_t i = 0; i < len; i++)
+        buf[i] = chunk[i % clen];
+    for (int i = 0; i < 64 * scale; i++)
+        pushLine(lines, buf, len);
+    free(buf);
+}
+
+static void genShortLines(benchLines *lines, int scale) {
+    char buf[32];
+    for (int i = 0; i < 200000 * scale; i++) {
+        int len = snprintf(buf, sizeof(buf), "x%d = %d;", i % 97, i);
+        pushLine(lines, buf, len);
+    }
+}
+
+static void genTabs(benchLines *lines, int scale) {
+    const char *rows[] = {"\t\tif\t(a)\t{\tb;\t}\t\t// x",
+                          "\t\t\t\t\t\t\t\tint\tvalue\t=\t1;",
+                          "\tcase\t1:\t\treturn\t\t2;", "\t\t\t\t"};
+    for (int i = 0; i < 50000 * scale; i++)
+        pushLine(lines, rows[i % 4], strlen(rows[i % 4]));
+}
+
+static void genComments(benchLines *lines, int scale) {
+    const char *rows[] = {
+        "/*",
+        " * Block comment with int and return keywords in it.",
+        " * Numbers 1234 and \"strings\" are not highlighted here.",
+        " */",
+        "static int counter = 0; // trailing comment",
+        "/* inline */ int value = 42; /* second */",
+        "char *name = \"not /* a comment */\";",
+        "for (int i = 0; i < 10; i++) { counter += i; }",
+    };
+    for (int i = 0; i < 50000 * scale; i++)
+        pushLine(lines, rows[i % 8], strlen(rows[i % 8]));
+}
+
+static benchWorkload workloads[] = {
+    {"long_lines", genLongLines},
+    {"short_lines", genShortLines},
+    {"tabs", genTabs},
+    {"comments", genComments},
+};
+#define WORKLOAD_ENTRIES (sizeof(workloads) / sizeof(workloads[0]))
+
+// BENCHMARKS
+
+static void runWorkload(benchWorkload *w, int scale) {
+    benchLines lines = {NULL, NULL, 0};
+    w->generate(&lines, scale);
+
+    editorInitState(48, 160);
+    E.filename = "bench.c";
+    editorSelectSyntaxHighlight();
+
+    size_t textlen = 0;
+    for (int i = 0; i < lines.n; i++)
+        textlen += lines.len[i] + 1;
+    char *text = malloc(textlen), *p = text;
+    for (int i = 0; i < lines.n; i++) {
+        memcpy(p, lines.line[i], lines.len[i]);
+        p += lines.len[i];
+        *p++ = '\n';
+    }
+    double t = nowMs();
+    loadText(text, textlen);
+    report(w->name, "loadText", lines.n, nowMs() - t);
+    free(text);
+    while (E.numrows)
+        editorDelRow(E.numrows - 1);
+
+    t = nowMs();
+    for (int i = 0; i < lines.n; i++)
+        editorInsertRow(E.numrows, lines.line[i], lines.len[i]);
+    report(w->name, "editorInsertRow", lines.n, nowMs() - t);
+
+    // The first lookup builds the index, the rest complete the first two
+    // characters of the rows.
+    const char *words[16];
+    t = nowMs();
+    completeLookup("", 0, words, 16);
+    report(w->name, "completeBuild", E.numrows, nowMs() - t);
+    int lookups = 0;
+    t = nowMs();
+    for (int i = 0; i < E.numrows && lookups < 100000; i += 7, lookups++)
+        completeLookup(E.row[i].chars, E.row[i].size < 2 ? E.row[i].size : 2,
+                       words, 16);
+    report(w->name, "completeLookup", lookups, nowMs() - t);
+    completeReset();
+
+    // The first bracket of every 7th row; the first call builds the tree.
+    int matches = 0;
+    t = nowMs();
+    for (int i = 0; i < E.numrows && matches < 100000; i += 7) {
+        char *b = strpbrk(E.row[i].chars, "()[]{}");
+        int row, rx;
+        if (b && bracketMatch(i, b - E.row[i].chars, &row, &rx))
+            matches++;
+    }
+    report(w->name, "bracketMatch", matches, nowMs() - t);
+
+    t = nowMs();
+    for (int i = 0; i < E.numrows; i++)
+        editorUpdateRow(&E.row[i]);
+    report(w->name, "editorUpdateRow", E.numrows, nowMs() - t);
+
+    t = nowMs();
+    for (int i = 0; i < E.numrows; i++)
+        editorUpdateSyntax(&E.row[i]);
+    report(w->name, "editorUpdateSyntax", E.numrows, nowMs() - t);
+
+    int reps = 5;
+    t = nowMs();
+    for (int i = 0; i < reps; i++) {
+        int len;
+        free(editorRowsToString(&len));
+    }
+    report(w->name, "editorRowsToString", reps, nowMs() - t);
+
+    t = nowMs();
+    for (int i = 0; i < reps; i++) {
+        int offset;
+        editorFindNext("no such needle", -1, 1, &offset);
+    }
+    report(w->name, "editorFindNext", reps, nowMs() - t);
+
+    // One frame per screenful, the way PAGE_DOWN walks the buffer.
+    int frames = 0;
+    t = nowMs();
+    for (E.rowoff = 0; E.rowoff < E.numrows && frames < 2000;
+         E.rowoff += E.screenRows, frames++) {
+        abuf buffer = ABUF_INIT;
+        editorDrawRows(&buffer);
+        abFree(&buffer);
+    }
+    report(w->name, "editorDrawRows", frames, nowMs() - t);
+    E.rowoff = 0;
+
+    // Every workload has an "=" on most rows, so this rebuilds nearly all.
+    t = nowMs();
+    long replaced = replaceAll("=", ":=");
+    report(w->name, "replaceAll", replaced, nowMs() - t);
+
+    // Deleting from the top shifts the whole row array every time.
+    int deletes = E.numrows < 1000 ? E.numrows : 1000;
+    t = nowMs();
+    for (int i = 0; i < deletes; i++)
+        editorDelRow(0);
+    report(w->name, "editorDelRow", deletes, nowMs() - t);
+
+    while (E.numrows)
+        editorDelRow(E.numrows - 1);
+    free(E.row);
+    for (int i = 0; i < lines.n; i++)
+        free(lines.line[i]);
+    free(lines.line);
+    free(lines.len);
+}
+
+int main(int argc, char *argv[]) {
+    int scale = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        if (opt == 's' && atoi(optarg) > 0) {
+            scale = atoi(optarg);
+        } else {
+            fprintf(stderr, "usage: %s [-s scale] [workload...]\n", argv[0]);
+            return 2;
+        }
+    }
+    for (unsigned int i = 0; i < WORKLOAD_ENTRIES; i++) {
+        int selected = optind == argc;
+        for (int j = optind; j < argc; j++)
+            if (!strcmp(argv[j], workloads[i].name))
+                selected = 1;
+        if (selected)
+            runWorkload(&workloads[i], scale);
+    }
+    return 0;
+}
@@ -0,0 +1,191 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "bracket.h"
+#include "editor.h"
+#include "trace.h"
+
+typedef struct bracketSum {
+    int close, open;
+} bracketSum;
+
+// Node k covers children 2k and 2k + 1, the leaves size .. 2 * size - 1 are
+// the rows themselves and are read from E.row.
+static struct {
+    bracketSum *node;
+    int size;
+    int valid; // the nodes are right about rows [0, valid)
+} B;
+
+static bracketSum bracketCombine(bracketSum a, bracketSum b) {
+    int pairs = a.open < b.close ? a.open : b.close;
+    bracketSum s = {a.close + b.close - pairs, a.open + b.open - pairs};
+    return s;
+}
+
+static bracketSum bracketGet(int k) {
+    bracketSum s = {0, 0};
+    if (k < B.size)
+        return B.node[k];
+    if (k - B.size < E.numrows) {
+        s.close = E.row[k - B.size].br_close;
+        s.open = E.row[k - B.size].br_open;
+    }
+    return s;
+}
+
+static int bracketIsOpen(int c) { return c == '(' || c == '[' || c == '{'; }
+
+static int bracketIsClose(int c) { return c == ')' || c == ']' || c == '}'; }
+
+static int bracketIsCode(int hl) {
+    return hl != HL_STRING && hl != HL_COMMENT && hl != HL_MLCOMMENT;
+}
+
+void bracketRowUpdate(erow *row) {
+    bracketSum s = {0, 0};
+    for (int i = 0; i < row->rsize; i++) {
+        char c = row->render[i];
+        if (!bracketIsCode(row->hl[i]))
+            continue;
+        if (bracketIsOpen(c))
+            s.open++;
+        else if (bracketIsClose(c)) {
+            if (s.open)
+                s.open--;
+            else
+                s.close++;
+        }
+    }
+    if (s.close == row->br_close && s.open == row->br_open)
+        return;
+    row->br_close = s.close;
+    row->br_open = s.open;
+    if (row->idx >= B.valid)
+        return;
+    for (int k = (row->idx + B.size) / 2; k > 0; k /= 2)
+        B.node[k] = bracketCombine(bracketGet(2 * k), bracketGet(2 * k + 1));
+}
+
+void bracketRowsMoved(int at) {
+    if (at < B.valid)
+        B.valid = at;
+}
+
+// Brings the tree up to date with E.row, which after an insert or delete
+// means redoing the nodes above the rows that moved.
+static void bracketSync(void) {
+    if (B.size < E.numrows) {
+        int size = B.size ? B.size : 1024;
+        while (size < E.numrows)
+            size *= 2;
+        B.node = realloc(B.node, sizeof(bracketSum) * size);
+        B.size = size;
+        B.valid = 0;
+    }
+    if (B.valid >= E.numrows)
+        return;
+    TRACE_BEGIN("bracketSync");
+    int lo = (B.valid + B.size) / 2, hi = B.size - 1;
+    for (; lo > 0; lo /= 2, hi /= 2)
+        for (int k = lo; k <= hi; k++)
+            B.node[k] =
+                bracketCombine(bracketGet(2 * k), bracketGet(2 * k + 1));
+    B.valid = E.numrows;
+    TRACE_END("bracketSync");
+}
+
+// Finds the first row at or after `from` that closes the `*depth` brackets
+// open before it, in the subtree of node k covering rows [lo, hi). Rows that
+// don't are skipped whole, updating *depth.
+static int bracketForward(int k, int lo, int hi, int from, int *depth) {
+    if (hi <= from)
+        return -1;
+    bracketSum s = bracketGet(k);
+    if (lo >= from && s.close < *depth) {
+        *depth += s.open - s.close;
+        return -1;
+    }
+    if (k >= B.size)
+        return lo;
+    int mid = lo + (hi - lo) / 2;
+    int row = bracketForward(2 * k, lo, mid, from, depth);
+    return row >= 0 ? row : bracketForward(2 * k + 1, mid, hi, from, depth);
+}
+
+// The same walking up from row `to`, exclusive.
+static int bracketBackward(int k, int lo, int hi, int to, int *depth) {
+    if (lo >= to)
+        return -1;
+    bracketSum s = bracketGet(k);
+    if (hi <= to && s.open < *depth) {
+        *depth += s.close - s.open;
+        return -1;
+    }
+    if (k >= B.size)
+        return lo;
+    int mid = lo + (hi - lo) / 2;
+    int row = bracketBackward(2 * k + 1, mid, hi, to, depth);
+    return row >= 0 ? row : bracketBackward(2 * k, lo, mid, to, depth);
+}
+
+// Scans the rendered row `at` from column `rx` on in `dir` until `depth`
+// brackets are closed, and returns the column it happens at, or -1.
+static int bracketScan(int at, int rx, int dir, int *depth) {
+    erow *row = &E.row[at];
+    for (int i = rx; i >= 0 && i < row->rsize; i += dir) {
+        char c = row->render[i];
+        if (!bracketIsCode(row->hl[i]))
+            continue;
+        if (dir > 0 ? bracketIsOpen(c) : bracketIsClose(c))
+            (*depth)++;
+        else if ((dir > 0 ? bracketIsClose(c) : bracketIsOpen(c)) &&
+                 --(*depth) == 0)
+            return i;
+    }
+    return -1;
+}
+
+int bracketMatch(int at, int cx, int *mrow, int *mrx) {
+    if (at < 0 || at >= E.numrows || cx >= E.row[at].size)
+        return 0;
+    erow *row = &E.row[at];
+    editorRowTouch(row);
+    int rx = editorRowCxToRx(row, cx);
+    char c = row->render[rx];
+    if (!bracketIsCode(row->hl[rx]) || !(bracketIsOpen(c) || bracketIsClose(c)))
+        return 0;
+    TRACE_BEGIN("bracketMatch");
+    int dir = bracketIsOpen(c) ? 1 : -1;
+    int depth = 1;
+    int col = bracketScan(at, rx + dir, dir, &depth);
+    int found = at;
+    if (col < 0) {
+        bracketSync();
+        found = dir > 0 ? bracketForward(1, 0, B.size, at + 1, &depth)
+                        : bracketBackward(1, 0, B.size, at, &depth);
+        if (found >= 0 && found < E.numrows) {
+            row = &E.row[found];
+            editorRowTouch(row);
+            col = bracketScan(found, dir > 0 ? 0 : row->rsize - 1, dir,
+                              &depth);
+        }
+    }
+    TRACE_END("bracketMatch");
+    if (col < 0)
+        return -1;
+    char m = E.row[found].render[col];
+    if (strchr("()[]{}", c) - strchr("()[]{}", m) != -dir)
+        return -1;
+    *mrow = found;
+    *mrx = col;
+    return 1;
+}
+
+void bracketUpdateMatch(void) {
+    int row, rx;
+    if (E.pager || bracketMatch(E.cursorY, E.cursorX, &row, &rx) != 1)
+        row = rx = -1;
+    E.match_row = row;
+    E.match_rx = rx;
+}
@@ -0,0 +1,27 @@
+#ifndef BRACKET_H
+#define BRACKET_H
+
+// Bracket matching. Every row keeps a summary of its brackets outside
+// strings and comments: once the pairs within the row cancel out, what is
+// left is some closing brackets followed by some opening ones. A segment
+// tree over the rows combines those summaries, so looking for a partner
+// skips whole runs of rows in O(log n) and only scans the row the partner
+// is in. All of ()[]{} share one nesting depth; a partner of the wrong kind
+// is reported as a mismatch.
+
+#include "editor.h"
+
+// Sums up the brackets of a row from its highlighting, right after
+// editorHighlightRow(). Rows that are loaded without being highlighted get
+// their summary from editorLexRow() instead.
+void bracketRowUpdate(erow *row);
+// Called when rows were inserted or deleted at `at`.
+void bracketRowsMoved(int at);
+// Looks for the partner of the bracket at column `cx` of row `at`. Returns
+// 1 and stores its position, in render columns, in *mrow and *mrx, 0 if
+// there is no bracket there, or -1 if it has no partner of its kind.
+int bracketMatch(int at, int cx, int *mrow, int *mrx);
+// Sets E.match_row and E.match_rx for the bracket at the cursor.
+void bracketUpdateMatch(void);
+
+#endif
@@ -0,0 +1,268 @@
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "complete.h"
+#include "trace.h"
+
+typedef struct completeWord {
+    char *s;
+    int len;
+    unsigned int hash;
+    int node; // where the word ends in the trie
+} completeWord;
+
+// Trie nodes refer to each other by index, node 0 being the root. Children
+// are kept in a sibling list sorted by character, unused nodes in a list
+// through sibling.
+typedef struct completeNode {
+    int child, sibling, parent;
+    int count; // occurrences of the word ending here
+    int live;  // words in this subtree with a count
+    int word;  // index into C.word, -1 if no word ends here
+    unsigned char c;
+} completeNode;
+
+static struct {
+    int built;
+    completeWord *word;
+    int nwords, wordcap;
+    int *slot; // index + 1 into C.word, 0 = empty
+    unsigned int mask;
+    completeNode *node;
+    int nnodes, nodecap;
+    int freenode; // 0 = none
+} C;
+
+static int completeIsWord(int c) { return isalnum(c) || c == '_'; }
+
+static unsigned int completeHash(const char *s, int len) {
+    unsigned int h = 2166136261u;
+    for (int i = 0; i < len; i++)
+        h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return h;
+}
+
+static int completeNewNode(int parent, unsigned char c) {
+    int at = C.freenode;
+    if (at) {
+        C.freenode = C.node[at].sibling;
+    } else {
+        if (C.nnodes == C.nodecap) {
+            C.nodecap = C.nodecap ? C.nodecap * 2 : 1024;
+            C.node = realloc(C.node, sizeof(completeNode) * C.nodecap);
+        }
+        at = C.nnodes++;
+    }
+    completeNode *n = &C.node[at];
+    memset(n, 0, sizeof(*n));
+    n->parent = parent;
+    n->word = -1;
+    n->c = c;
+    return at;
+}
+
+// Returns the child of `parent` for `c`, adding it when `add` is set, or 0.
+static int completeChild(int parent, unsigned char c, int add) {
+    int prev = 0, n = C.node[parent].child;
+    while (n && C.node[n].c < c) {
+        prev = n;
+        n = C.node[n].sibling;
+    }
+    if (n && C.node[n].c == c)
+        return n;
+    if (!add)
+        return 0;
+    int added = completeNewNode(parent, c);
+    C.node[added].sibling = n;
+    if (prev)
+        C.node[prev].sibling = added;
+    else
+        C.node[parent].child = added;
+    return added;
+}
+
+static void completeGrow(void) {
+    unsigned int size = C.mask ? (C.mask + 1) * 2 : 4096;
+    free(C.slot);
+    C.slot = calloc(size, sizeof(int));
+    C.mask = size - 1;
+    for (int i = 0; i < C.nwords; i++) {
+        unsigned int h = C.word[i].hash & C.mask;
+        while (C.slot[h])
+            h = (h + 1) & C.mask;
+        C.slot[h] = i + 1;
+    }
+}
+
+// Finds the word, adding it to the table and the trie if it is new.
+static completeWord *completeFind(const char *s, int len) {
+    if ((unsigned int)C.nwords * 4 >= C.mask * 3)
+        completeGrow();
+    unsigned int hash = completeHash(s, len);
+    unsigned int h = hash & C.mask;
+    for (; C.slot[h]; h = (h + 1) & C.mask) {
+        completeWord *w = &C.word[C.slot[h] - 1];
+        if (w->hash == hash && w->len == len && !memcmp(w->s, s, len))
+            return w;
+    }
+    if (C.nwords == C.wordcap) {
+        C.wordcap = C.wordcap ? C.wordcap * 2 : 1024;
+        C.word = realloc(C.word, sizeof(completeWord) * C.wordcap);
+    }
+    int node = 0;
+    for (int i = 0; i < len; i++)
+        node = completeChild(node, s[i], 1);
+    C.node[node].word = C.nwords;
+    completeWord *w = &C.word[C.nwords];
+    w->s = malloc(len + 1);
+    memcpy(w->s, s, len);
+    w->s[len] = '\0';
+    w->len = len;
+    w->hash = hash;
+    w->node = node;
+    C.slot[h] = ++C.nwords;
+    return w;
+}
+
+static unsigned int completeSlotOf(int word) {
+    unsigned int h = C.word[word].hash & C.mask;
+    while (C.slot[h] != word + 1)
+        h = (h + 1) & C.mask;
+    return h;
+}
+
+// Empties slot `h`, moving later entries of the probe sequence back so that
+// none of them ends up behind an empty slot.
+static void completeUnslot(unsigned int h) {
+    for (;;) {
+        C.slot[h] = 0;
+        unsigned int j = h, home;
+        do {
+            j = (j + 1) & C.mask;
+            if (C.slot[j] == 0)
+                return;
+            home = C.word[C.slot[j] - 1].hash & C.mask;
+        } while (h <= j ? h < home && home <= j : h < home || home <= j);
+        C.slot[h] = C.slot[j];
+        h = j;
+    }
+}
+
+// Forgets a word that no longer occurs, along with the trie nodes that lead
+// only to it. Otherwise every prefix typed on the way to a word would stay.
+static void completeDrop(int word) {
+    completeUnslot(completeSlotOf(word));
+    free(C.word[word].s);
+    int node = C.word[word].node;
+    C.node[node].word = -1;
+    while (node && !C.node[node].child && C.node[node].word == -1) {
+        int parent = C.node[node].parent;
+        int *link = &C.node[parent].child;
+        while (*link != node)
+            link = &C.node[*link].sibling;
+        *link = C.node[node].sibling;
+        C.node[node].sibling = C.freenode;
+        C.freenode = node;
+        node = parent;
+    }
+    // the last word takes its place
+    int last = --C.nwords;
+    if (word != last) {
+        C.slot[completeSlotOf(last)] = word + 1;
+        C.word[word] = C.word[last];
+        C.node[C.word[word].node].word = word;
+    }
+}
+
+static void completeCount(const char *s, int len, int delta) {
+    completeWord *w = completeFind(s, len);
+    int node = w->node;
+    int before = C.node[node].count;
+    C.node[node].count += delta;
+    if ((before == 0) == (C.node[node].count == 0))
+        return;
+    int live = before ? -1 : 1;
+    for (int n = node; n; n = C.node[n].parent)
+        C.node[n].live += live;
+    C.node[0].live += live;
+    if (C.node[node].count == 0)
+        completeDrop(w - C.word);
+}
+
+static void completeRow(erow *row, int delta) {
+    const char *s = row->chars, *end = s + row->size;
+    while (s < end) {
+        if (!completeIsWord((unsigned char)*s)) {
+            s++;
+            continue;
+        }
+        const char *start = s;
+        while (s < end && completeIsWord((unsigned char)*s))
+            s++;
+        if (!isdigit((unsigned char)*start) && s - start <= COMPLETE_MAX_WORD)
+            completeCount(start, s - start, delta);
+    }
+}
+
+void completeRowAdd(erow *row) {
+    if (C.built)
+        completeRow(row, 1);
+}
+
+void completeRowRemove(erow *row) {
+    if (C.built)
+        completeRow(row, -1);
+}
+
+// The node after `cur` in a walk of the subtree under `top` that skips
+// subtrees without live words, or 0 at the end.
+static int completeNext(int top, int cur) {
+    int n = C.node[cur].child;
+    while (n && !C.node[n].live)
+        n = C.node[n].sibling;
+    if (n)
+        return n;
+    for (; cur != top; cur = C.node[cur].parent) {
+        n = C.node[cur].sibling;
+        while (n && !C.node[n].live)
+            n = C.node[n].sibling;
+        if (n)
+            return n;
+    }
+    return 0;
+}
+
+int completeLookup(const char *prefix, int len, const char **out, int max) {
+    TRACE_BEGIN("completeLookup");
+    if (!C.built) {
+        TRACE_BEGIN("completeBuild");
+        completeNewNode(0, 0);
+        C.built = 1;
+        for (int i = 0; i < E.numrows; i++)
+            completeRow(&E.row[i], 1);
+        TRACE_END("completeBuild");
+    }
+    int top = 0, i;
+    for (i = 0; i < len; i++)
+        if ((top = completeChild(top, prefix[i], 0)) == 0)
+            break;
+    int n = 0;
+    if (i == len) {
+        for (int cur = completeNext(top, top); cur && n < max;
+             cur = completeNext(top, cur))
+            if (C.node[cur].count)
+                out[n++] = C.word[C.node[cur].word].s;
+    }
+    TRACE_END("completeLookup");
+    return n;
+}
+
+void completeReset(void) {
+    for (int i = 0; i < C.nwords; i++)
+        free(C.word[i].s);
+    free(C.word);
+    free(C.slot);
+    free(C.node);
+    memset(&C, 0, sizeof(C));
+}
@@ -0,0 +1,27 @@
+#ifndef COMPLETE_H
+#define COMPLETE_H
+
+// Word completion from an index of the identifiers in the buffer: a hash
+// table counts the occurrences of every word and a prefix trie over the
+// same words answers lookups without looking at the rows. The index is
+// built on the first lookup, after that the edit functions of editor.c keep
+// it current by taking a row's words out before they change the row and
+// putting them back after, so an edit costs time in the length of the row.
+// Words are counted wherever they appear, comments and strings included, so
+// that a row's words never depend on the rows above it. A word whose count
+// drops to zero is removed, so the index doesn't grow with what is typed.
+
+#include "editor.h"
+
+#define COMPLETE_MAX_WORD 64 // longer runs of word characters are skipped
+
+void completeRowAdd(erow *row);
+void completeRowRemove(erow *row);
+// Stores up to `max` words in the buffer that extend `prefix` in `out`, in
+// alphabetical order, and returns how many. The words stay valid until the
+// buffer changes.
+int completeLookup(const char *prefix, int len, const char **out, int max);
+// Drops the index, the next lookup builds it again.
+void completeReset(void);
+
+#endif
@@ -0,0 +1,983 @@
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bracket.h"
+#include "complete.h"
+#include "editor.h"
+#include "pager.h"
+#include "slab.h"
+#include "trace.h"
+
+editorConfig E;
+
+char *extensions[] = {".c", ".h", ".cpp", NULL};
+char *keyword[] = {"switch",    "if",      "while",   "for",    "break",
+                   "continue",  "return",  "else",    "struct", "union",
+                   "typedef",   "static",  "enum",    "class",  "case",
+                   "int|",      "long|",   "double|", "float|", "char|",
+                   "unsigned|", "signed|", "void|",   NULL};
+struct editorSyntax HLDB[] = {
+    {"c", extensions, keyword, "//", "/*", "*/",
+     HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS},
+};
+#define HLDB_ENTRIES (sizeof(HLDB) / sizeof(HLDB[0]))
+
+// Resets the buffer and view state. The caller supplies the text area size,
+// which the terminal front end gets from getWindowSize().
+void editorInitState(int rows, int columns) {
+    E.cursorX = 0;
+    E.cursorY = 0;
+    E.rx = 0;
+    E.rowoff = 0;
+    E.coloff = 0;
+    E.numrows = 0;
+    E.rowcap = 0;
+    E.row = NULL;
+    E.dirty = 0;
+    E.filename = NULL;
+    E.gzip = 0;
+    E.statusmsg[0] = '\0';
+    E.statusmsg_time = 0;
+    E.syntax = NULL;
+    E.pager = 0;
+    E.hud = 0;
+    E.frame = 0;
+    E.cache_budget = KILO_CACHE_BUDGET;
+    E.load_threads = 0;
+    E.match_row = -1;
+    memset(&E.stats, 0, sizeof(E.stats));
+    E.screenRows = rows;
+    E.screenColumns = columns;
+}
+
+double editorNowMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// Closes the stats interval for a frame that took `frame_ms` to build and
+// produced `frame_bytes` of output.
+void editorStatsFrame(double frame_ms, int frame_bytes) {
+    E.stats.last_frame_ms = frame_ms;
+    E.stats.last_frame_bytes = frame_bytes;
+    E.stats.last_reallocs = E.stats.reallocs - E.stats.reallocs_mark;
+    E.stats.reallocs_mark = E.stats.reallocs;
+    E.stats.last_syntax_ms = E.stats.syntax_ms;
+    E.stats.syntax_ms = 0;
+}
+
+// Draws the visible part of a row, from E.coloff on.
+void editorDrawRow(abuf *buffer, erow *row) {
+    int len = row->rsize - E.coloff;
+    if (len < 0)
+        len = 0;
+    if (len > E.screenColumns)
+        len = E.screenColumns;
+    char *c = &row->render[E.coloff];
+    unsigned char *hl = &row->hl[E.coloff];
+    int current_color = -1;
+    int match = row->idx == E.match_row ? E.match_rx - E.coloff : -1;
+    for (int i = 0; i < len; i++) {
+        if (i == match)
+            abAppend(buffer, "\x1b[7m", 4);
+        if (iscntrl(c[i])) {
+            char sym = (c[i] <= 26) ? '@' + c[i] : '?';
+            abAppend(buffer, "\x1b[7m", 4);
+            abAppend(buffer, &sym, 1);
+            abAppend(buffer, "\x1b[m", 3);
+            if (current_color != -1) {
+                char buf[16];
+                int clen =
+                    snprintf(buf, sizeof(buf), "\x1b[%dm", current_color);
+                abAppend(buffer, buf, clen);
+            }
+        } else if (hl[i] == HL_NORMAL) {
+            if (current_color != -1) {
+                abAppend(buffer, "\x1b[39m", 5);
+                current_color = -1;
+            }
+            abAppend(buffer, &c[i], 1);
+        } else {
+            int color = editorSyntaxToColor(hl[i]);
+            if (color != current_color) {
+                current_color = color;
+                char buf[32];
+                int clen = snprintf(buf, sizeof(buf), "\x1b[%dm", color);
+                abAppend(buffer, buf, clen);
+            }
+            abAppend(buffer, &c[i], 1);
+        }
+        if (i == match)
+            abAppend(buffer, "\x1b[27m", 5);
+    }
+    abAppend(buffer, "\x1b[39m", 5);
+}
+
+void editorDrawRows(abuf *buffer) {
+    E.frame++;
+    editorCacheTrim();
+    for (int i = 0; i < E.screenRows; i++) {
+        int filerow = i + E.rowoff;
+        erow *row = NULL;
+        if (E.pager) {
+            row = pagerRow(filerow);
+        } else if (filerow < E.numrows) {
+            row = &E.row[filerow];
+            editorRowTouch(row);
+        }
+        if (row) {
+            editorDrawRow(buffer, row);
+        } else if (E.numrows == 0 && !E.pager && i == E.screenRows / 3) {
+            char welcome[80];
+            int welcomelen =
+                snprintf(welcome, sizeof(welcome), "Kilo Editor -- version %s",
+                         KILO_VERSION);
+            if (welcomelen > E.screenColumns)
+                welcomelen = E.screenColumns;
+            int padding = (E.screenColumns - welcomelen) / 2;
+            if (padding) {
+                abAppend(buffer, "~", 1);
+                padding--;
+            }
+            while (padding--)
+                abAppend(buffer, " ", 1);
+            abAppend(buffer, welcome, welcomelen);
+        } else {
+            abAppend(buffer, "~", 1);
+        }
+        abAppend(buffer, "\x1b[K", 3);
+        abAppend(buffer, "\r\n", 2);
+    }
+}
+
+void abAppend(abuf *buffer, const char *string, int len) {
+    char *new = realloc(buffer->b, buffer->len + len);
+    E.stats.reallocs++;
+    if (new == NULL)
+        return;
+    memcpy(&new[buffer->len], string, len);
+    buffer->b = new;
+    buffer->len += len;
+}
+void abFree(abuf *buffer) { free(buffer->b); }
+
+// Grows the row array to hold at least `n` rows, doubling so that appending
+// rows one at a time stays amortized O(1).
+void editorReserveRows(int n) {
+    if (n <= E.rowcap)
+        return;
+    int cap = E.rowcap ? E.rowcap : 16;
+    while (cap < n)
+        cap *= 2;
+    E.row = realloc(E.row, sizeof(erow) * cap);
+    E.stats.reallocs++;
+    E.rowcap = cap;
+}
+
+void editorInsertRow(int at, char *str, size_t len) {
+    if (at < 0 || E.numrows < at)
+        return;
+
+    editorReserveRows(E.numrows + 1);
+    memmove(&E.row[at + 1], &E.row[at], sizeof(erow) * (E.numrows - at));
+    bracketRowsMoved(at);
+    for (int j = at + 1; j <= E.numrows; j++)
+        E.row[j].idx++;
+
+    E.row[at].idx = at;
+    E.row[at].size = len;
+    E.row[at].chars = slabAllocText(len + 1);
+    memcpy(E.row[at].chars, str, len);
+    E.row[at].chars[len] = '\0';
+    E.row[at].rsize = 0;
+    E.row[at].render = NULL;
+    E.row[at].hl = NULL;
+    E.row[at].hl_open_comment = 0;
+    E.row[at].br_close = E.row[at].br_open = 0;
+    E.stats.chars_bytes += len + 1;
+    completeRowAdd(&E.row[at]);
+    editorUpdateRow(&E.row[at]);
+    E.numrows++;
+    E.dirty++;
+    editorCacheTrim();
+}
+
+void editorScroll() {
+    // the pager moves the view itself and has no cursor column
+    if (E.pager) {
+        E.rx = E.coloff;
+        return;
+    }
+    E.rx = 0;
+    if (E.cursorY < E.numrows)
+        E.rx = editorRowCxToRx(&E.row[E.cursorY], E.cursorX);
+    if (E.rx < E.coloff) {
+        E.coloff = E.rx;
+    }
+    if (E.cursorY < E.rowoff) {
+        E.rowoff = E.cursorY;
+    }
+    if (E.rx >= E.coloff + E.screenColumns) {
+        E.coloff = E.rx - E.screenColumns + 1;
+    }
+    if (E.cursorY >= E.rowoff + E.screenRows) {
+        E.rowoff = E.cursorY - E.screenRows + 1;
+    }
+}
+// Expands tabs from chars into render.
+void editorRenderRow(erow *row) {
+    int tabs = 0;
+    for (int j = 0; j < row->size; j++) {
+        if (row->chars[j] == '\t')
+            tabs++;
+    }
+    if (row->render) {
+        E.stats.render_bytes -= row->rsize + 1;
+        E.stats.hl_bytes -= row->rsize;
+    }
+    row->render =
+        slabRealloc(row->render, 0, row->size + tabs * (KILO_TAB_STOP - 1) + 1);
+    int idx = 0;
+    for (int j = 0; j < row->size; j++) {
+        if (row->chars[j] == '\t') {
+            row->render[idx++] = ' ';
+            while (idx % KILO_TAB_STOP != 0)
+                row->render[idx++] = ' ';
+        } else
+            row->render[idx++] = row->chars[j];
+    }
+    row->render[idx] = '\0';
+    row->rsize = idx;
+    E.stats.render_bytes += row->rsize + 1;
+    E.stats.hl_bytes += row->rsize;
+    row->stamp = E.frame;
+}
+
+void editorUpdateRow(erow *row) {
+    editorRenderRow(row);
+    editorUpdateSyntax(row);
+}
+
+// RENDER CACHE
+//
+// render and hl are derived from chars plus the hl_open_comment of the
+// previous row, so they can be dropped for rows nobody is looking at and
+// rebuilt on demand. Each row carries the frame it was last used in; when
+// render+hl go over E.cache_budget, editorCacheTrim() evicts the least
+// recently used rows away from the viewport until usage is back under 3/4
+// of the budget.
+
+static void editorEvictRow(erow *row) {
+    E.stats.render_bytes -= row->rsize + 1;
+    E.stats.hl_bytes -= row->rsize;
+    slabFree(row->render);
+    slabFree(row->hl);
+    row->render = NULL;
+    row->hl = NULL;
+}
+
+// Makes sure render and hl of a row are resident and marks it as used by the
+// current frame. Must be called before reading either of them.
+void editorRowTouch(erow *row) {
+    if (row->render == NULL) {
+        editorRenderRow(row);
+        row->hl = slabAlloc(row->rsize);
+        int in_comment =
+            row->idx > 0 && E.row[row->idx - 1].hl_open_comment;
+        editorHighlightRow(row, in_comment);
+        E.stats.regenerations++;
+    }
+    row->stamp = E.frame;
+}
+
+#define CACHE_BUCKETS 64
+
+// Approximate LRU without sorting or extra memory: resident rows are
+// bucketed by age, whole buckets are evicted oldest first and the boundary
+// bucket is evicted farthest-from-the-viewport first.
+void editorCacheTrim() {
+    size_t resident = E.stats.render_bytes + E.stats.hl_bytes;
+    if (E.cache_budget == 0 || resident <= E.cache_budget)
+        return;
+    size_t target = E.cache_budget / 4 * 3;
+    int lo = E.rowoff - E.screenRows;
+    int hi = E.rowoff + 2 * E.screenRows;
+    unsigned int oldest = E.frame, newest = 0;
+    for (int i = 0; i < E.numrows; i++) {
+        erow *row = &E.row[i];
+        if (row->render && (i < lo || i > hi)) {
+            if (row->stamp < oldest)
+                oldest = row->stamp;
+            if (row->stamp > newest)
+                newest = row->stamp;
+        }
+    }
+    if (oldest > newest)
+        return;
+    unsigned int width = (newest - oldest) / CACHE_BUCKETS + 1;
+    size_t bytes[CACHE_BUCKETS] = {0};
+    for (int i = 0; i < E.numrows; i++) {
+        erow *row = &E.row[i];
+        if (row->render && (i < lo || i > hi))
+            bytes[(row->stamp - oldest) / width] += 2 * row->rsize + 1;
+    }
+    unsigned int cutoff = 0;
+    size_t freed = 0;
+    while (cutoff < CACHE_BUCKETS - 1 &&
+           freed + bytes[cutoff] < resident - target)
+        freed += bytes[cutoff++];
+
+    int top = 0, bottom = E.numrows - 1;
+    while (top <= bottom) {
+        int i;
+        if (top < lo && (bottom <= hi || lo - top >= bottom - hi))
+            i = top++;
+        else if (bottom > hi)
+            i = bottom--;
+        else
+            break;
+        erow *row = &E.row[i];
+        if (!row->render)
+            continue;
+        unsigned int bucket = (row->stamp - oldest) / width;
+        if (bucket < cutoff || (bucket == cutoff && resident > target)) {
+            resident -= 2 * row->rsize + 1;
+            editorEvictRow(row);
+            E.stats.evictions++;
+        }
+    }
+}
+
+int editorRowCxToRx(erow *row, int cursorX) {
+    int rx = 0;
+    for (int j = 0; j < cursorX; j++) {
+        if (row->chars[j] == '\t')
+            rx += (KILO_TAB_STOP - 1) - (rx % KILO_TAB_STOP);
+        rx++;
+    }
+    return rx;
+}
+
+// Formats a byte count as a short human readable string, e.g. "12.3M".
+static char *editorFormatBytes(char *buf, size_t bytes) {
+    const char *units = "BKMGT";
+    double value = bytes;
+    while (value >= 1024 && units[1]) {
+        value /= 1024;
+        units++;
+    }
+    sprintf(buf, value < 10 && *units != 'B' ? "%.1f%c" : "%.0f%c", value,
+            *units);
+    return buf;
+}
+
+// The performance HUD replaces the left half of the status bar with the
+// stats of the last frame and the heap held by rows. "idle" is the share of
+// slab pages sitting on free lists, i.e. fragmentation.
+static int editorDrawHud(char *status, size_t size) {
+    char c[16], r[16], h[16], b[16], s[16];
+    size_t held, idle;
+    slabStats(&held, &idle);
+    return snprintf(status, size,
+                    "frame %.2fms %dB | %ld realloc | syntax %.3fms | "
+                    "chars %s render %s hl %s / %s, %ld evicted | "
+                    "slab %s %.0f%% idle",
+                    E.stats.last_frame_ms, E.stats.last_frame_bytes,
+                    E.stats.last_reallocs, E.stats.last_syntax_ms,
+                    editorFormatBytes(c, E.stats.chars_bytes),
+                    editorFormatBytes(r, E.stats.render_bytes),
+                    editorFormatBytes(h, E.stats.hl_bytes),
+                    E.cache_budget ? editorFormatBytes(b, E.cache_budget)
+                                   : "unlimited",
+                    E.stats.evictions, editorFormatBytes(s, held),
+                    held ? 100.0 * idle / held : 0.0);
+}
+
+void editorDrawStatusBar(abuf *buffer) {
+    abAppend(buffer, "\x1b[7m", 4);
+    char status[192], rstatus[80];
+    int complete = 1;
+    int numrows = E.pager ? pagerLineCount(&complete) : E.numrows;
+    int rlen = snprintf(rstatus, sizeof(rstatus), "%s | %d/%d%s",
+                        E.syntax ? E.syntax->filetype : "no ft", E.cursorY + 1,
+                        numrows, complete ? "" : "+");
+    int len;
+    if (E.hud)
+        len = editorDrawHud(status, sizeof(status));
+    else if (E.pager)
+        len = snprintf(status, sizeof(status),
+                       "%.20s - %d%s Lines (read-only)", E.filename, numrows,
+                       complete ? "" : "+");
+    else
+        len = snprintf(status, sizeof(status), "%.20s - %d Lines %s",
+                       E.filename ? E.filename : "[No Name]", E.numrows,
+                       E.dirty ? "(modified)" : " ");
+    if (len >= (int)sizeof(status))
+        len = sizeof(status) - 1;
+    if (len > E.screenColumns)
+        len = E.screenColumns;
+    abAppend(buffer, status, len);
+    while (len < E.screenColumns) {
+        if (E.screenColumns - len == rlen) {
+            abAppend(buffer, rstatus, rlen);
+            break;
+        } else {
+            abAppend(buffer, " ", 1);
+            len++;
+        }
+    }
+    abAppend(buffer, "\x1b[m", 3);
+    abAppend(buffer, "\r\n", 2);
+}
+
+void editorSetStatusMessage(const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(E.statusmsg, sizeof(E.statusmsg), fmt, ap);
+    va_end(ap);
+    E.statusmsg_time = time(NULL);
+}
+
+void editorDrawStatusMessage(abuf *buffer) {
+    abAppend(buffer, "\x1b[K", 3);
+    int msglen = strlen(E.statusmsg);
+    if (msglen > E.screenColumns)
+        msglen = E.screenColumns;
+    if (msglen && time(NULL) - E.statusmsg_time < 5)
+        abAppend(buffer, E.statusmsg, msglen);
+}
+
+void editorRowInsertChar(erow *row, int at, int c) {
+    if (at < 0 || at > row->size)
+        at = row->size;
+    completeRowRemove(row);
+    row->chars = slabRealloc(row->chars, row->size + 1, row->size + 2);
+    E.stats.reallocs++;
+    E.stats.chars_bytes++;
+    memmove(&row->chars[at + 1], &row->chars[at], row->size - at + 1);
+    row->size++;
+    row->chars[at] = c;
+    completeRowAdd(row);
+    editorUpdateRow(row);
+    E.dirty++;
+}
+
+void editorInsertChar(int c) {
+    if (E.cursorY == E.numrows) {
+        editorInsertRow(E.numrows, "", 0);
+    }
+    editorRowInsertChar(&E.row[E.cursorY], E.cursorX, c);
+    E.cursorX++;
+}
+
+char *editorRowsToString(int *buflen) {
+    int totlen = 0;
+    for (int i = 0; i < E.numrows; i++) {
+        totlen += E.row[i].size + 1;
+    }
+    *buflen = totlen;
+    char *buf = malloc(totlen);
+    char *p = buf;
+    for (int i = 0; i < E.numrows; i++) {
+        memcpy(p, E.row[i].chars, E.row[i].size);
+        p += E.row[i].size;
+        *p = '\n';
+        p++;
+    }
+    return buf;
+}
+void editorDelChar() {
+    if (E.cursorY == E.numrows)
+        return;
+    if (E.cursorX == 0 && E.cursorY == 0)
+        return;
+    erow *row = &E.row[E.cursorY];
+    if (E.cursorX > 0) {
+        editorRowDelChar(row, E.cursorX - 1);
+        E.cursorX--;
+    } else {
+        E.cursorX = E.row[E.cursorY - 1].size;
+        editorRowAppendString(&E.row[E.cursorY - 1], row->chars, row->size);
+        editorDelRow(E.cursorY);
+        E.cursorY--;
+    }
+}
+void editorRowDelChar(erow *row, int at) {
+    if (at < 0 || at >= row->size)
+        return;
+    completeRowRemove(row);
+    memmove(&row->chars[at], &row->chars[at + 1], row->size - at);
+    row->size--;
+    E.stats.chars_bytes--;
+    completeRowAdd(row);
+    editorUpdateRow(row);
+    E.dirty++;
+}
+
+void editorFreeRow(erow *row) {
+    E.stats.chars_bytes -= row->size + 1;
+    if (row->render) {
+        E.stats.render_bytes -= row->rsize + 1;
+        E.stats.hl_bytes -= row->rsize;
+    }
+    slabFree(row->chars);
+    slabFree(row->render);
+    slabFree(row->hl);
+}
+// Empties the buffer, to load another file into it.
+void editorResetBuffer() {
+    for (int i = 0; i < E.numrows; i++)
+        editorFreeRow(&E.row[i]);
+    E.numrows = 0;
+    completeReset();
+    bracketRowsMoved(0);
+    E.cursorX = E.cursorY = 0;
+    E.rowoff = E.coloff = 0;
+    E.dirty = 0;
+    free(E.filename);
+    E.filename = NULL;
+    E.gzip = 0;
+    E.syntax = NULL;
+    E.match_row = -1;
+}
+void editorDelRow(int at) {
+    if (at < 0 || at >= E.numrows)
+        return;
+    completeRowRemove(&E.row[at]);
+    editorFreeRow(&E.row[at]);
+    memmove(&E.row[at], &E.row[at + 1], sizeof(erow) * (E.numrows - at - 1));
+    bracketRowsMoved(at);
+    for (int i = at; i < E.numrows - 1; i++) {
+        E.row[i].idx--;
+    }
+    E.numrows--;
+    E.dirty++;
+}
+void editorRowAppendString(erow *row, char *s, size_t len) {
+    completeRowRemove(row);
+    row->chars = slabRealloc(row->chars, row->size + 1, row->size + len + 1);
+    E.stats.reallocs++;
+    E.stats.chars_bytes += len;
+    memcpy(&row->chars[row->size], s, len);
+    row->size += len;
+    row->chars[row->size] = '\0';
+    completeRowAdd(row);
+    editorUpdateRow(row);
+    E.dirty++;
+}
+void editorInsertNewLine() {
+    if (E.cursorX == 0) {
+        editorInsertRow(E.cursorY, "", 0);
+    } else {
+        erow *row = &E.row[E.cursorY];
+        editorInsertRow(E.cursorY + 1, &row->chars[E.cursorX],
+                        row->size - E.cursorX);
+        row = &E.row[E.cursorY];
+        completeRowRemove(row);
+        E.stats.chars_bytes -= row->size - E.cursorX;
+        row->size = E.cursorX;
+        row->chars[row->size] = '\0';
+        completeRowAdd(row);
+        editorUpdateRow(row);
+    }
+    E.cursorY++;
+    E.cursorX = 0;
+}
+
+// Drops the '\r's a finished line ends in, which may have come with an
+// earlier piece of text than its '\n'.
+static void editorTrimLine(erow *row) {
+    while (row->size > 0 && row->chars[row->size - 1] == '\r')
+        editorRowDelChar(row, row->size - 1);
+}
+
+// Appends text read from a file or pipe to the end of the buffer, one row
+// per line. When `partial` is set, the last row is an unterminated line that
+// the text continues. Returns whether the buffer now ends in an unterminated
+// line. Text coming from the file itself does not make the buffer dirty.
+// Lines lose their trailing '\r's as in loadText(), unterminated ones once
+// the rest of them arrives or editorEndText() says there is no more.
+int editorAppendText(const char *buf, size_t len, int partial) {
+    int dirty = E.dirty;
+    const char *end = buf + len;
+    if (partial && E.numrows > 0 && len > 0) {
+        const char *nl = memchr(buf, '\n', len);
+        const char *stop = nl ? nl : end;
+        size_t linelen = stop - buf;
+        while (nl && linelen > 0 && buf[linelen - 1] == '\r')
+            linelen--;
+        editorRowAppendString(&E.row[E.numrows - 1], (char *)buf, linelen);
+        if (nl)
+            editorTrimLine(&E.row[E.numrows - 1]);
+        buf = nl ? nl + 1 : end;
+        partial = nl == NULL;
+    }
+    int lines = 0;
+    for (const char *p = buf; (p = memchr(p, '\n', end - p)); p++)
+        lines++;
+    editorReserveRows(E.numrows + lines + 1);
+    slabArenaBegin();
+    while (buf < end) {
+        const char *nl = memchr(buf, '\n', end - buf);
+        const char *stop = nl ? nl : end;
+        size_t linelen = stop - buf;
+        while (nl && linelen > 0 && buf[linelen - 1] == '\r')
+            linelen--;
+        editorInsertRow(E.numrows, (char *)buf, linelen);
+        partial = nl == NULL;
+        buf = nl ? nl + 1 : end;
+    }
+    slabArenaEnd();
+    E.dirty = dirty;
+    return partial;
+}
+
+void editorEndText(int partial) {
+    if (partial && E.numrows > 0) {
+        int dirty = E.dirty;
+        editorTrimLine(&E.row[E.numrows - 1]);
+        E.dirty = dirty;
+    }
+}
+
+// Looks for `query` in the rows after `from`, walking in `direction` and
+// wrapping around the buffer. Returns the matching row index and stores the
+// match position within its render in *offset, or returns -1.
+int editorFindNext(const char *query, int from, int direction, int *offset) {
+    int current = from;
+    for (int i = 0; i < E.numrows; i++) {
+        current += direction;
+        if (current == -1)
+            current = E.numrows - 1;
+        else if (current == E.numrows)
+            current = 0;
+        // chars is always resident, render may have been evicted
+        erow *row = &E.row[current];
+        char *match = strstr(row->chars, query);
+        if (match) {
+            *offset = editorRowCxToRx(row, match - row->chars);
+            return current;
+        }
+    }
+    return -1;
+}
+
+int editorRowRxToCx(erow *row, int rx) {
+    int cur_rx = 0;
+    int cursorX;
+    for (cursorX = 0; cursorX < row->size; cursorX++) {
+        if (row->chars[cursorX] == '\t')
+            cur_rx += (KILO_TAB_STOP - 1) - (cur_rx % KILO_TAB_STOP);
+        cur_rx++;
+        if (cur_rx > rx)
+            return cursorX;
+    }
+    return cursorX;
+}
+
+// Highlights one row whose first character starts inside a multiline comment
+// when `in_comment` is set. Returns whether the row ends inside one. Nothing
+// else is touched, so this never cascades into the following rows.
+int editorHighlightRow(erow *row, int in_comment) {
+    memset(row->hl, HL_NORMAL, row->rsize);
+    if (E.syntax == NULL)
+        return 0;
+    char **keywords = E.syntax->keywords;
+    char *scs = E.syntax->single_line_comment;
+    char *mcs = E.syntax->multiline_comment_start;
+    char *mce = E.syntax->multiline_comment_end;
+    int scs_len = scs ? strlen(scs) : 0;
+    int mcs_len = mcs ? strlen(mcs) : 0;
+    int mce_len = mcs ? strlen(mce) : 0;
+    int prev_sep = 1;
+    int in_string = 0;
+    int i = 0;
+    while (i < row->rsize) {
+        char c = row->render[i];
+        unsigned char prev_hl = (i > 0) ? row->hl[i - 1] : HL_NORMAL;
+        if (scs_len && !in_string && !in_comment) {
+            if (!strncmp(&row->render[i], scs, scs_len)) {
+                memset(&row->hl[i], HL_COMMENT, row->rsize - i);
+                break;
+            }
+        }
+        if (mcs_len && mce_len && !in_string) {
+            if (in_comment) {
+                row->hl[i] = HL_COMMENT;
+                if (!strncmp(&row->render[i], mce, mce_len)) {
+                    memset(&row->hl[i], HL_MLCOMMENT, mce_len);
+                    i += mce_len;
+                    in_comment = 0;
+                    prev_sep = 1;
+                    continue;
+                } else {
+                    i++;
+                    continue;
+                }
+            } else if (!strncmp(&row->render[i], mcs, mcs_len)) {
+                memset(&row->hl[i], HL_MLCOMMENT, mcs_len);
+                i += mcs_len;
+                in_comment = 1;
+                continue;
+            }
+        }
+        if (E.syntax->flags & HL_HIGHLIGHT_STRINGS) {
+            if (in_string) {
+                row->hl[i] = HL_STRING;
+                if (c == '\\' && i + 1 < row->rsize) {
+                    row->hl[i + 1] = HL_STRING;
+                    i += 2;
+                    continue;
+                }
+                if (c == in_string)
+                    in_string = 0;
+                i++;
+                prev_sep = 1;
+                continue;
+            } else {
+                if (c == '"' || c == '\'') {
+                    in_string = c;
+                    row->hl[i] = HL_STRING;
+                    i++;
+                    continue;
+                }
+            }
+        }
+        if (E.syntax->flags & HL_HIGHLIGHT_NUMBERS) {
+            if ((isdigit(c) && (prev_sep || prev_hl == HL_NUMBER)) ||
+                (c == '.' && prev_hl == HL_NUMBER)) {
+                row->hl[i] = HL_NUMBER;
+                i++;
+                prev_sep = 0;
+                continue;
+            }
+        }
+        if (prev_sep) {
+            int j;
+            for (j = 0; keywords[j]; j++) {
+                int klen = strlen(keywords[j]);
+                int kw2 = keywords[j][klen - 1] == '|';
+                if (kw2)
+                    klen--;
+                if (!strncmp(&row->render[i], keywords[j], klen) &&
+                    is_separator(row->render[i + klen])) {
+                    memset(&row->hl[i], kw2 ? HL_KEYWORD2 : HL_KEYWORD1, klen);
+                    i += klen;
+                    break;
+                }
+            }
+            if (keywords[j] != NULL) {
+                prev_sep = 0;
+                continue;
+            }
+        }
+        prev_sep = is_separator(c);
+        i++;
+    }
+    return in_comment;
+}
+
+enum { LEX_PLAIN, LEX_QUOTE, LEX_OPEN, LEX_CLOSE };
+
+static const unsigned char editorLexClass[256] = {
+    ['"'] = LEX_QUOTE, ['\''] = LEX_QUOTE, ['('] = LEX_OPEN,
+    ['['] = LEX_OPEN,  ['{'] = LEX_OPEN,    [')'] = LEX_CLOSE,
+    [']'] = LEX_CLOSE, ['}'] = LEX_CLOSE,
+};
+
+// Counts a bracket outside strings and comments into the row summary kept
+// for bracket.c: closing brackets without a partner in the row, then
+// opening ones.
+static void editorLexBracket(int cls, int *close, int *open) {
+    if (cls == LEX_OPEN)
+        (*open)++;
+    else if (cls == LEX_CLOSE && *open)
+        (*open)--;
+    else if (cls == LEX_CLOSE)
+        (*close)++;
+}
+
+// The lexer behind editorCommentState() and editorLexRow(). Brackets are
+// only looked at when `close` is given.
+static int editorLex(const char *s, size_t len, int in_comment, int *close,
+                     int *open) {
+    struct editorSyntax *syntax = E.syntax;
+    char *scs = syntax ? syntax->single_line_comment : NULL;
+    char *mcs = syntax ? syntax->multiline_comment_start : NULL;
+    char *mce = syntax ? syntax->multiline_comment_end : NULL;
+    size_t scs_len = scs ? strlen(scs) : 0;
+    size_t mcs_len = mcs ? strlen(mcs) : 0;
+    size_t mce_len = mcs ? strlen(mce) : 0;
+    if (!mcs_len || !mce_len) {
+        if (close == NULL)
+            return 0;
+        mcs_len = mce_len = 0;
+        in_comment = 0;
+    }
+    int strings = syntax && (syntax->flags & HL_HIGHLIGHT_STRINGS);
+    char sc = scs_len ? scs[0] : '\0', mc = mcs_len ? mcs[0] : '\0';
+    size_t i = 0;
+    while (i < len) {
+        if (in_comment) {
+            char *end = memmem(s + i, len - i, mce, mce_len);
+            if (end == NULL)
+                break;
+            i = end - s + mce_len;
+            in_comment = 0;
+            continue;
+        }
+        // only quotes and these bytes can start a string or a comment
+        char c = s[i];
+        int cls = editorLexClass[(unsigned char)c];
+        if (cls != LEX_QUOTE && c != sc && c != mc) {
+            if (close && cls != LEX_PLAIN)
+                editorLexBracket(cls, close, open);
+            i++;
+        } else if (strings && cls == LEX_QUOTE) {
+            // skip the string, which ends with the line at the latest
+            for (i++; i < len && s[i] != c; i++)
+                if (s[i] == '\\' && i + 1 < len)
+                    i++;
+            i++;
+        } else if (scs_len && i + scs_len <= len &&
+                   !memcmp(s + i, scs, scs_len)) {
+            break;
+        } else if (mcs_len && i + mcs_len <= len &&
+                   !memcmp(s + i, mcs, mcs_len)) {
+            i += mcs_len;
+            in_comment = 1;
+        } else {
+            if (close)
+                editorLexBracket(cls, close, open);
+            i++;
+        }
+    }
+    return in_comment;
+}
+
+// Returns the multiline comment state at the end of line `s` by the rules of
+// editorHighlightRow(), without rendering or highlighting it. Safe to call
+// from other threads as long as E.syntax doesn't change.
+int editorCommentState(const char *s, size_t len, int in_comment) {
+    return editorLex(s, len, in_comment, NULL, NULL);
+}
+
+// Like editorCommentState(), but also fills in the row's bracket summary.
+int editorLexRow(erow *row, int in_comment) {
+    row->br_close = row->br_open = 0;
+    return editorLex(row->chars, row->size, in_comment, &row->br_close,
+                     &row->br_open);
+}
+
+// Re-highlights a row, then keeps going down the buffer for as long as the
+// multiline comment state at the end of a row changes. Evicted rows on the
+// way are rendered just long enough to be scanned.
+void editorUpdateSyntax(erow *row) {
+    double start = E.hud ? editorNowMs() : 0;
+    TRACE_BEGIN("editorUpdateSyntax");
+    int in_comment = row->idx > 0 && E.row[row->idx - 1].hl_open_comment;
+    while (1) {
+        int evicted = row->render == NULL;
+        if (evicted)
+            editorRenderRow(row);
+        row->hl = slabRealloc(row->hl, 0, row->rsize);
+        E.stats.reallocs++;
+        in_comment = editorHighlightRow(row, in_comment);
+        bracketRowUpdate(row);
+        int changed = (row->hl_open_comment != in_comment);
+        row->hl_open_comment = in_comment;
+        if (evicted)
+            editorEvictRow(row);
+        if (!changed || row->idx + 1 >= E.numrows)
+            break;
+        row = &E.row[row->idx + 1];
+    }
+    if (start)
+        E.stats.syntax_ms += editorNowMs() - start;
+    TRACE_END("editorUpdateSyntax");
+}
+
+// Rebuilds rows [from, to] after a batch edit changed their chars, in a
+// single top-down pass, then continues below `to` like editorUpdateSyntax()
+// while the comment state keeps changing, stopping short of row `limit`.
+// Evicted rows stay evicted.
+void editorUpdateRows(int from, int to, int limit) {
+    double start = E.hud ? editorNowMs() : 0;
+    TRACE_BEGIN("editorUpdateRows");
+    int in_comment = from > 0 && E.row[from - 1].hl_open_comment;
+    for (int i = from; i < limit; i++) {
+        erow *row = &E.row[i];
+        int evicted = row->render == NULL;
+        if (evicted || i <= to)
+            editorRenderRow(row);
+        row->hl = slabRealloc(row->hl, 0, row->rsize);
+        E.stats.reallocs++;
+        in_comment = editorHighlightRow(row, in_comment);
+        bracketRowUpdate(row);
+        int changed = (row->hl_open_comment != in_comment);
+        row->hl_open_comment = in_comment;
+        if (evicted)
+            editorEvictRow(row);
+        if (i >= to && !changed)
+            break;
+    }
+    if (start)
+        E.stats.syntax_ms += editorNowMs() - start;
+    TRACE_END("editorUpdateRows");
+}
+
+int editorSyntaxToColor(int hl) {
+    switch (hl) {
+    case HL_KEYWORD1:
+        return 33;
+    case HL_KEYWORD2:
+        return 32;
+    case HL_MLCOMMENT:
+    case HL_COMMENT:
+        return 36;
+    case HL_NUMBER:
+        return 34;
+    case HL_STRING:
+        return 35;
+    case HL_MATCH:
+        return 31;
+    default:
+        return 37;
+    };
+}
+
+int is_separator(int c) {
+    return isspace(c) || c == '\0' || strchr(",.()+-/*=~%<>[];", c) != NULL;
+}
+
+void editorSelectSyntaxHighlight() {
+    E.syntax = NULL;
+    if (E.filename == NULL)
+        return;
+    char *ext = strrchr(E.filename, '.');
+    for (unsigned int i = 0; i < HLDB_ENTRIES; i++) {
+        struct editorSyntax *s = &HLDB[i];
+        unsigned int j = 0;
+        while (s->filematch[j]) {
+            int is_ext = (s->filematch[j][0] == '.');
+            if ((is_ext && ext && !strcmp(ext, s->filematch[j])) ||
+                (!is_ext && strstr(E.filename, s->filematch[j]))) {
+                E.syntax = s;
+                for (int filerow = 0; filerow < E.numrows; filerow++) {
+                    editorUpdateSyntax(&E.row[filerow]);
+                }
+                return;
+            }
+            j++;
+        }
+    }
+}
@@ -0,0 +1,173 @@
+#ifndef EDITOR_H
+#define EDITOR_H
+
+// Editor core: rows, syntax highlighting, search and screen composition.
+// Nothing in here touches the terminal, so it can be linked into other
+// binaries (see bench/micro.c) as long as they fill in E themselves.
+
+#include <stddef.h>
+#include <termios.h>
+#include <time.h>
+
+#define KILO_VERSION "0.0.1"
+#define KILO_TAB_STOP 8
+#define KILO_QUIT_TIMES 3
+#define KILO_CACHE_BUDGET (256UL << 20)
+#define CTRL_KEY(k) ((k) & 0x1f)
+#define HL_HIGHLIGHT_NUMBERS (1 << 0)
+#define HL_HIGHLIGHT_STRINGS (1 << 1)
+
+// TODO: Colorful serch results
+struct editorSyntax {
+    char *filetype;
+    char **filematch;
+    char **keywords;
+    char *single_line_comment;
+    char *multiline_comment_start;
+    char *multiline_comment_end;
+    int flags;
+};
+
+typedef struct erow {
+    int idx;
+    int size;
+    int rsize;
+    char *chars;
+    char *render;
+    unsigned char *hl;
+    int hl_open_comment;
+    unsigned int stamp; // E.frame when render/hl were last used
+    // brackets outside strings and comments left unmatched within the row,
+    // the closing ones come first (see bracket.h)
+    int br_close, br_open;
+} erow;
+
+// Counters behind the performance HUD. The running counters cover
+// everything since the previous frame, the last_* copies are what the HUD
+// shows.
+typedef struct editorStats {
+    long reallocs;
+    long reallocs_mark;
+    double syntax_ms;
+    size_t chars_bytes;
+    size_t render_bytes;
+    size_t hl_bytes;
+    double last_frame_ms;
+    int last_frame_bytes;
+    long last_reallocs;
+    double last_syntax_ms;
+    long evictions;
+    long regenerations;
+} editorStats;
+
+typedef struct editorConfig {
+    int cursorX, cursorY;
+    int screenRows;
+    int rx;
+    int screenColumns;
+    int rowoff;
+    int coloff;
+    int dirty;
+    struct termios orig_termios;
+    int ttyfd; // the keyboard, STDIN_FILENO unless stdin is the buffer
+    int numrows;
+    int rowcap;
+    erow *row;
+    char *filename;
+    int gzip; // the file is gzip compressed on disk, and saved that way
+    char statusmsg[160];
+    time_t statusmsg_time;
+    struct editorSyntax *syntax;
+    int pager; // read-only view backed by pager.c, E.row stays empty
+    int hud;
+    editorStats stats;
+    unsigned int frame;
+    size_t cache_budget; // bytes of render+hl to keep resident, 0 = no limit
+    int load_threads; // chunks loadText() cuts the text into, 0 = per core
+    int match_row, match_rx; // bracket matching the one at the cursor, or -1
+} editorConfig;
+
+typedef struct abuf {
+    char *b;
+    int len;
+} abuf;
+
+enum editorKey {
+    BACKSPACE = 127,
+    DEL_KEY,
+    ARROW_LEFT = 1000,
+    ARROW_RIGHT,
+    ARROW_UP,
+    ARROW_DOWN,
+    DEL,
+    HOME,
+    END,
+    PAGE_UP,
+    PAGE_DOWN,
+};
+
+enum editorHighlight {
+    HL_NORMAL = 0,
+    HL_COMMENT,
+    HL_MLCOMMENT,
+    HL_KEYWORD1,
+    HL_KEYWORD2,
+    HL_STRING,
+    HL_NUMBER,
+    HL_MATCH
+};
+
+#define ABUF_INIT {NULL, 0}
+
+// Return flags of the handlers of background sources (followed files,
+// pipes, ...) that the main loop polls alongside the keyboard.
+#define SOURCE_REDRAW (1 << 0) // the screen needs to be refreshed
+#define SOURCE_MORE (1 << 1)   // work left over, call again when idle
+
+extern editorConfig E;
+
+// FUNCTIONS
+
+void editorInitState(int rows, int columns);
+double editorNowMs();
+void editorStatsFrame(double frame_ms, int frame_bytes);
+void editorDrawRow(abuf *buffer, erow *row);
+void editorDrawRows(abuf *buffer);
+void editorDrawStatusBar(abuf *buffer);
+void abAppend(abuf *buffer, const char *string, int len);
+void abFree(abuf *buffer);
+void editorReserveRows(int n);
+void editorInsertRow(int at, char *str, size_t len);
+int editorAppendText(const char *buf, size_t len, int partial);
+// Finishes text appended with editorAppendText(), which returned `partial`.
+void editorEndText(int partial);
+void editorScroll();
+void editorRenderRow(erow *row);
+void editorUpdateRow(erow *row);
+void editorRowTouch(erow *row);
+void editorCacheTrim();
+int editorRowCxToRx(erow *row, int cursorX);
+int editorRowRxToCx(erow *row, int rx);
+void editorSetStatusMessage(const char *fmt, ...);
+void editorDrawStatusMessage(abuf *buffer);
+void editorRowInsertChar(erow *row, int at, int c);
+void editorInsertChar(int c);
+char *editorRowsToString(int *buflen);
+void editorDelChar();
+void editorResetBuffer();
+void editorRowDelChar(erow *row, int at);
+void editorFreeRow(erow *row);
+void editorDelRow(int at);
+void editorRowAppendString(erow *row, char *s, size_t len);
+void editorInsertNewLine();
+int editorFindNext(const char *query, int from, int direction, int *offset);
+int editorHighlightRow(erow *row, int in_comment);
+int editorCommentState(const char *s, size_t len, int in_comment);
+int editorLexRow(erow *row, int in_comment);
+void editorUpdateSyntax(erow *row);
+void editorUpdateRows(int from, int to, int limit);
+int editorSyntaxToColor(int hl);
+int is_separator(int c);
+void editorSelectSyntaxHighlight();
+
+#endif
@@ -0,0 +1,165 @@
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <libgen.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "editor.h"
+#include "follow.h"
+#include "trace.h"
+
+// Upper bound on what one followHandle() call ingests. Anything beyond that
+// is left for the next call, after the main loop has checked the keyboard.
+#define FOLLOW_BATCH_BYTES (1 << 20)
+
+typedef struct followState {
+    char *path;
+    int fd;
+    int inotify;
+    int wd;
+    int dirwd;    // the directory, for a new file showing up at the path
+    char *base;   // the file's name within the directory
+    off_t offset; // bytes of the file already in the buffer
+    int partial;  // the last row is a line still being written
+    int rotated;  // the file was moved or deleted, reopen it once drained
+    char *buf;
+} followState;
+
+static followState F = {NULL, -1, -1, -1, -1, NULL, 0, 0, 0, NULL};
+
+static int followWatch() {
+    F.wd = inotify_add_watch(F.inotify, F.path,
+                             IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF |
+                                 IN_DELETE_SELF);
+    return F.wd;
+}
+
+int followStart(const char *filename) {
+    F.path = strdup(filename);
+    F.fd = open(filename, O_RDONLY);
+    if (F.fd == -1)
+        return -1;
+    F.inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (F.inotify == -1 || followWatch() == -1)
+        return -1;
+    // Not being able to watch the directory only means a file that is gone
+    // for a moment isn't picked up again.
+    char *dir = strdup(filename), *base = strdup(filename);
+    F.dirwd = inotify_add_watch(F.inotify, dirname(dir),
+                                IN_CREATE | IN_MOVED_TO);
+    F.base = strdup(basename(base));
+    free(dir);
+    free(base);
+    F.buf = malloc(FOLLOW_BATCH_BYTES);
+    free(E.filename);
+    E.filename = strdup(filename);
+    editorSelectSyntaxHighlight();
+    return F.inotify;
+}
+
+// The old file is fully read; switch to whatever now lives at the path. If
+// nothing does yet, the directory watch tries again once something appears.
+static void followReopen() {
+    if (F.fd != -1) {
+        inotify_rm_watch(F.inotify, F.wd);
+        close(F.fd);
+    }
+    F.rotated = 0;
+    F.offset = 0;
+    F.partial = 0;
+    F.fd = open(F.path, O_RDONLY);
+    if (F.fd != -1 && followWatch() == -1) {
+        close(F.fd);
+        F.fd = -1;
+    }
+    if (F.fd == -1) {
+        editorSetStatusMessage(F.dirwd == -1
+                                   ? "%s is gone, no longer following"
+                                   : "%s is gone, waiting for it to return",
+                               F.path);
+        return;
+    }
+    editorSetStatusMessage("%s was rotated, following the new file", F.path);
+}
+
+// Whether the file being read is no longer the one at the path. Deleting a
+// file that is still open only changes its link count, so all there is to
+// go by is IN_ATTRIB.
+static int followReplaced() {
+    struct stat st, now;
+    if (fstat(F.fd, &st) == -1 || st.st_nlink == 0)
+        return 1;
+    return stat(F.path, &now) == -1 || now.st_ino != st.st_ino ||
+           now.st_dev != st.st_dev;
+}
+
+int followHandle(void) {
+    char events[4096];
+    ssize_t n;
+    while ((n = read(F.inotify, events, sizeof(events))) > 0) {
+        for (char *p = events; p < events + n;) {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            // Events about the old file can still come in after a reopen,
+            // so each one is checked against what is at the path now.
+            int check = ev->wd == F.dirwd
+                            ? ev->len && !strcmp(ev->name, F.base)
+                            : ev->wd == F.wd && F.fd != -1 &&
+                                  (ev->mask & (IN_ATTRIB | IN_MOVE_SELF |
+                                               IN_DELETE_SELF));
+            if (check && (F.fd == -1 || followReplaced()))
+                F.rotated = 1;
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+    if (F.fd == -1) {
+        if (!F.rotated)
+            return 0;
+        followReopen();
+        // the new file may have been written before it was watched
+        return F.fd == -1 ? SOURCE_REDRAW : SOURCE_REDRAW | SOURCE_MORE;
+    }
+
+    int redraw = 0;
+    struct stat st;
+    if (fstat(F.fd, &st) == 0 && st.st_size < F.offset) {
+        // What was read is gone from the file, so it goes from the buffer.
+        editorResetBuffer();
+        E.filename = strdup(F.path);
+        editorSelectSyntaxHighlight();
+        editorSetStatusMessage("%s was truncated, following from the start",
+                               F.path);
+        F.offset = 0;
+        F.partial = 0;
+        redraw = 1;
+    }
+
+    TRACE_BEGIN("followHandle");
+    n = pread(F.fd, F.buf, FOLLOW_BATCH_BYTES, F.offset);
+    if (n > 0) {
+        // Stay pinned to the end unless the user has moved away from it.
+        int pinned = E.numrows == 0 || E.cursorY >= E.numrows - 1;
+        F.partial = editorAppendText(F.buf, n, F.partial);
+        F.offset += n;
+        if (pinned && E.cursorY != E.numrows - 1) {
+            E.cursorY = E.numrows - 1;
+            E.cursorX = 0;
+        }
+    } else if (F.rotated) {
+        followReopen();
+        redraw = 1;
+    }
+    TRACE_END("followHandle");
+
+    int flags = n > 0 || redraw ? SOURCE_REDRAW : 0;
+    if (n == FOLLOW_BATCH_BYTES || (F.rotated && n > 0) ||
+        (n <= 0 && redraw && F.fd != -1))
+        flags |= SOURCE_MORE;
+    return flags;
+}
@@ -0,0 +1,12 @@
+#ifndef FOLLOW_H
+#define FOLLOW_H
+
+// Follow mode (-f): the file is loaded incrementally and then watched with
+// inotify, appending whatever gets written to it, like `tail -f`.
+
+// Starts following `filename` and returns the inotify descriptor to poll.
+int followStart(const char *filename);
+// Source handler, returns SOURCE_* flags.
+int followHandle(void);
+
+#endif
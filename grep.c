@@ -0,0 +1,409 @@
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "editor.h"
+#include "grep.h"
+#include "trace.h"
+
+#define GREP_MAX_THREADS 64
+#define GREP_MAX_RESULTS 100000
+#define GREP_LINE_MAX 256      // bytes of a matching line that are shown
+#define GREP_BINARY_PROBE 8192 // a NUL byte in here makes a file binary
+
+// The results of one file. Not an abuf, as abAppend() counts reallocs in E.
+typedef struct grepResults {
+    char *b;
+    size_t len, cap;
+} grepResults;
+
+typedef struct grepItem {
+    char *path;
+    int dir;
+} grepItem;
+
+// Every worker owns a deque of files and directories still to search. It
+// pushes and pops at the back, so it goes depth first; idle workers steal
+// from the front, which holds the work closest to the top of the tree.
+typedef struct grepWorker {
+    pthread_mutex_t lock; // guards the deque
+    grepItem *item;
+    int head, tail, cap;
+    size_t bytes;
+    long files;
+    int started;
+    pthread_t thread;
+} grepWorker;
+
+static struct {
+    char *query;
+    size_t qlen;
+    int rare;     // offset of the byte of the query that memchr looks for
+    int event;    // eventfd, signaled when there are results or all is done
+    int pending;  // items pushed and not done yet
+    int running;  // workers that haven't exited
+    int stop;     // set on grepClose() or when there are too many results
+    // Filled by the workers, guarded by lock.
+    pthread_mutex_t lock;
+    grepResults out;
+    long matches;
+    // Main thread only.
+    int nworkers;
+    grepWorker worker[GREP_MAX_THREADS];
+    int active; // workers are running or haven't been joined yet
+    int shown;
+    grepResults taken;
+    double start;
+} G = {.lock = PTHREAD_MUTEX_INITIALIZER, .event = -1};
+
+// How common a byte is in source code and text, roughly. The literal is
+// searched for by its least common byte.
+static int grepRank(unsigned char c) {
+    if (strchr("etaoinsr \t\n", c))
+        return 3;
+    if (islower(c) && !strchr("qzxjkvwybg", c))
+        return 2;
+    if (strchr("();,.-_=*/\"':{}[]<>01", c))
+        return 2;
+    if (isalnum(c))
+        return 1;
+    return 0;
+}
+
+static void grepPush(grepWorker *w, char *path, int dir) {
+    __atomic_add_fetch(&G.pending, 1, __ATOMIC_ACQ_REL);
+    pthread_mutex_lock(&w->lock);
+    if (w->tail == w->cap) {
+        if (w->head > 0) {
+            memmove(w->item, w->item + w->head,
+                    sizeof(grepItem) * (w->tail - w->head));
+            w->tail -= w->head;
+            w->head = 0;
+        } else {
+            w->cap = w->cap ? w->cap * 2 : 64;
+            w->item = realloc(w->item, sizeof(grepItem) * w->cap);
+        }
+    }
+    w->item[w->tail].path = path;
+    w->item[w->tail].dir = dir;
+    w->tail++;
+    pthread_mutex_unlock(&w->lock);
+}
+
+// Takes an item from the back of the worker's own deque, or with `steal`
+// from the front of another's.
+static int grepTake(grepWorker *w, int steal, grepItem *it) {
+    int found = 0;
+    pthread_mutex_lock(&w->lock);
+    if (w->head < w->tail) {
+        *it = steal ? w->item[w->head++] : w->item[--w->tail];
+        found = 1;
+    }
+    if (w->head == w->tail)
+        w->head = w->tail = 0;
+    pthread_mutex_unlock(&w->lock);
+    return found;
+}
+
+static void grepWake(void) {
+    uint64_t one = 1;
+    write(G.event, &one, sizeof(one));
+}
+
+static void grepAppend(grepResults *r, const char *s, size_t len) {
+    if (r->len + len > r->cap) {
+        r->cap = r->cap ? r->cap * 2 : 4096;
+        while (r->len + len > r->cap)
+            r->cap *= 2;
+        r->b = realloc(r->b, r->cap);
+    }
+    memcpy(r->b + r->len, s, len);
+    r->len += len;
+}
+
+// Hands the results of one file over to the main thread.
+static void grepEmit(grepResults *results, long matches) {
+    pthread_mutex_lock(&G.lock);
+    int wake = G.out.len == 0;
+    grepAppend(&G.out, results->b, results->len);
+    G.matches += matches;
+    if (G.matches >= GREP_MAX_RESULTS)
+        __atomic_store_n(&G.stop, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&G.lock);
+    if (wake)
+        grepWake();
+}
+
+// Finds the query in [p, end). memchr looks for its least common byte,
+// which libc does many bytes at a time, and the rest is compared at each
+// hit.
+static const char *grepFind(const char *p, const char *end) {
+    const char *last = end - G.qlen + G.rare + 1;
+    char c = G.query[G.rare];
+    for (p += G.rare; p < last && (p = memchr(p, c, last - p)); p++)
+        if (!memcmp(p - G.rare, G.query, G.qlen))
+            return p - G.rare;
+    return NULL;
+}
+
+static void grepFile(grepWorker *w, const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return;
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) ||
+        st.st_size < (off_t)G.qlen || st.st_size == 0) {
+        close(fd);
+        return;
+    }
+    char *text = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (text == MAP_FAILED)
+        return;
+    madvise(text, st.st_size, MADV_SEQUENTIAL);
+    size_t probe = st.st_size < GREP_BINARY_PROBE ? st.st_size
+                                                  : GREP_BINARY_PROBE;
+    if (memchr(text, '\0', probe)) {
+        munmap(text, st.st_size);
+        return;
+    }
+    w->files++;
+    w->bytes += st.st_size;
+    const char *end = text + st.st_size;
+    grepResults results = {NULL, 0, 0};
+    long matches = 0;
+    const char *p = text, *line_start = text;
+    int line = 1;
+    const char *m;
+    while ((m = grepFind(p, end))) {
+        for (const char *nl; (nl = memchr(p, '\n', m - p)); p = nl + 1) {
+            line++;
+            line_start = nl + 1;
+        }
+        const char *line_end = memchr(m, '\n', end - m);
+        if (line_end == NULL)
+            line_end = end;
+        int len = line_end - line_start;
+        while (len > 0 && line_start[len - 1] == '\r')
+            len--;
+        if (len > GREP_LINE_MAX)
+            len = GREP_LINE_MAX;
+        char head[32];
+        grepAppend(&results, path, strlen(path));
+        grepAppend(&results, head,
+                   snprintf(head, sizeof(head), ":%d:", line));
+        grepAppend(&results, line_start, len);
+        grepAppend(&results, "\n", 1);
+        matches++;
+        if (line_end == end)
+            break;
+        p = line_start = line_end + 1;
+        line++;
+    }
+    if (matches)
+        grepEmit(&results, matches);
+    free(results.b);
+    munmap(text, st.st_size);
+}
+
+// Queues what is in a directory. Hidden entries like .git are skipped, and
+// so are symlinks, so the walk can't loop.
+static void grepDir(grepWorker *w, const char *path) {
+    DIR *d = opendir(path);
+    if (d == NULL)
+        return;
+    struct dirent *de;
+    while ((de = readdir(d))) {
+        if (de->d_name[0] == '.')
+            continue;
+        char *child;
+        if (!strcmp(path, "."))
+            child = strdup(de->d_name);
+        else if (asprintf(&child, "%s/%s", path, de->d_name) == -1)
+            continue;
+        int type = de->d_type;
+        if (type == DT_UNKNOWN) {
+            struct stat st;
+            type = lstat(child, &st) == -1 ? DT_UNKNOWN
+                   : S_ISDIR(st.st_mode)   ? DT_DIR
+                   : S_ISREG(st.st_mode)   ? DT_REG
+                                           : DT_UNKNOWN;
+        }
+        if (type == DT_DIR || type == DT_REG)
+            grepPush(w, child, type == DT_DIR);
+        else
+            free(child);
+    }
+    closedir(d);
+}
+
+static void *grepWork(void *arg) {
+    grepWorker *w = arg;
+    int self = w - G.worker;
+    TRACE_BEGIN("grepWork");
+    while (!__atomic_load_n(&G.stop, __ATOMIC_RELAXED)) {
+        grepItem it;
+        int found = grepTake(w, 0, &it);
+        for (int i = 1; !found && i < G.nworkers; i++)
+            found = grepTake(&G.worker[(self + i) % G.nworkers], 1, &it);
+        if (!found) {
+            // the others may still queue more
+            if (__atomic_load_n(&G.pending, __ATOMIC_ACQUIRE) == 0)
+                break;
+            struct timespec nap = {0, 100000};
+            nanosleep(&nap, NULL);
+            continue;
+        }
+        if (it.dir)
+            grepDir(w, it.path);
+        else
+            grepFile(w, it.path);
+        free(it.path);
+        __atomic_sub_fetch(&G.pending, 1, __ATOMIC_ACQ_REL);
+    }
+    TRACE_END("grepWork");
+    if (__atomic_sub_fetch(&G.running, 1, __ATOMIC_ACQ_REL) == 0)
+        grepWake();
+    return NULL;
+}
+
+// Joins the workers, which have stopped or are about to, and drops what a
+// stop left queued.
+static void grepFinish(void) {
+    size_t bytes = 0;
+    long files = 0;
+    for (int t = 0; t < G.nworkers; t++)
+        if (G.worker[t].started)
+            pthread_join(G.worker[t].thread, NULL);
+    for (int t = 0; t < G.nworkers; t++) {
+        grepWorker *w = &G.worker[t];
+        for (int i = w->head; i < w->tail; i++)
+            free(w->item[i].path);
+        free(w->item);
+        pthread_mutex_destroy(&w->lock);
+        bytes += w->bytes;
+        files += w->files;
+    }
+    if (G.shown) {
+        double ms = editorNowMs() - G.start;
+        editorSetStatusMessage(
+            "%s%ld matches for %s in %ld files, %.1fMB in %.0fms",
+            G.matches >= GREP_MAX_RESULTS ? "Stopped at " : "", G.matches,
+            G.query, files, bytes / 1e6, ms);
+    }
+    free(G.query);
+    G.query = NULL;
+    G.active = 0;
+}
+
+int grepStart(const char *query, const char *dir) {
+    if (*query == '\0')
+        return -1;
+    if (G.active) {
+        // the last search, stopped by grepClose()
+        __atomic_store_n(&G.stop, 1, __ATOMIC_RELAXED);
+        grepFinish();
+    }
+    if (G.event == -1 &&
+        (G.event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1)
+        return -1;
+    G.query = strdup(query);
+    G.qlen = strlen(query);
+    G.rare = 0;
+    for (size_t i = 1; i < G.qlen; i++)
+        if (grepRank(G.query[i]) < grepRank(G.query[G.rare]))
+            G.rare = i;
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    G.nworkers = n < 1 ? 1 : n > GREP_MAX_THREADS ? GREP_MAX_THREADS : n;
+    G.pending = 0;
+    G.running = G.nworkers;
+    G.stop = 0;
+    G.out.len = 0;
+    G.matches = 0;
+    for (int t = 0; t < G.nworkers; t++) {
+        grepWorker *w = &G.worker[t];
+        pthread_mutex_init(&w->lock, NULL);
+        w->item = NULL;
+        w->head = w->tail = w->cap = 0;
+        w->bytes = 0;
+        w->files = 0;
+    }
+    grepPush(&G.worker[0], strdup(dir), 1);
+    G.active = 1;
+    G.shown = 1;
+    G.start = editorNowMs();
+    for (int t = 0; t < G.nworkers; t++) {
+        grepWorker *w = &G.worker[t];
+        w->started = pthread_create(&w->thread, NULL, grepWork, w) == 0;
+        // the items of a worker that didn't start get stolen
+        if (!w->started &&
+            __atomic_sub_fetch(&G.running, 1, __ATOMIC_ACQ_REL) == 0)
+            grepWake();
+    }
+    return G.event;
+}
+
+int grepHandle(void) {
+    uint64_t n;
+    read(G.event, &n, sizeof(n));
+    pthread_mutex_lock(&G.lock);
+    grepResults taken = G.out;
+    G.out = G.taken;
+    G.out.len = 0;
+    G.taken = taken;
+    long matches = G.matches;
+    int done = G.active && __atomic_load_n(&G.running, __ATOMIC_ACQUIRE) == 0;
+    pthread_mutex_unlock(&G.lock);
+    int flags = 0;
+    if (G.shown && taken.len > 0) {
+        TRACE_BEGIN("grepHandle");
+        editorAppendText(taken.b, taken.len, 0);
+        TRACE_END("grepHandle");
+        editorSetStatusMessage("Searching for %s... %ld matches", G.query,
+                               matches);
+        flags = SOURCE_REDRAW;
+    }
+    if (done) {
+        grepFinish();
+        flags = SOURCE_REDRAW;
+    }
+    return flags;
+}
+
+int grepShown(void) { return G.shown; }
+
+void grepClose(void) {
+    G.shown = 0;
+    __atomic_store_n(&G.stop, 1, __ATOMIC_RELAXED);
+}
+
+char *grepResultAt(int at, int *line) {
+    if (at < 0 || at >= E.numrows)
+        return NULL;
+    erow *row = &E.row[at];
+    // the first ":<digits>:", in case the path has a colon in it
+    for (char *p = row->chars; (p = strchr(p, ':')); p++) {
+        char *q = p + 1;
+        while (isdigit((unsigned char)*q))
+            q++;
+        if (q > p + 1 && *q == ':') {
+            *line = atoi(p + 1);
+            return strndup(row->chars, p - row->chars);
+        }
+    }
+    return NULL;
+}
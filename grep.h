@@ -0,0 +1,23 @@
+#ifndef GREP_H
+#define GREP_H
+
+// Project-wide search (Ctrl-T): worker threads walk a directory tree and
+// search every file for a literal, and the matches stream into the buffer
+// as "path:line:text" rows while the search goes on. Enter on such a row
+// opens the file at that line.
+
+// Starts searching `dir` for `query`, the buffer is expected to be empty. A
+// search still running is stopped first. Returns a descriptor that becomes
+// readable when there are new results, the same one every time, or -1.
+int grepStart(const char *query, const char *dir);
+// Source handler, returns SOURCE_* flags.
+int grepHandle(void);
+// Whether the buffer holds the results of a search.
+int grepShown(void);
+// Stops showing results, anything still being found is dropped.
+void grepClose(void);
+// Parses a result row into the file name and line it points at. Returns the
+// file name, to be freed, or NULL.
+char *grepResultAt(int at, int *line);
+
+#endif
@@ -0,0 +1,245 @@
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "gzindex.h"
+
+#define WINSIZE 32768
+#define CHUNK 16384
+#define RECENT (1 << 20)
+
+typedef struct gzindexPoint {
+    off_t out; // offset in the output
+    off_t in;  // offset of the first full input byte of the block
+    int bits;  // bits of the byte before `in` that belong to the block
+    unsigned char window[WINSIZE];
+} gzindexPoint;
+
+typedef struct gzindexState {
+    int fd;
+    // Appended to by gzindexBuild(), guarded by lock. Points are never
+    // freed or moved, so a reader may keep using one after unlocking.
+    pthread_mutex_t lock;
+    gzindexPoint **point;
+    int npoints;
+    int cappoints;
+    // The reading cursor, only used by gzindexRead().
+    z_stream strm;
+    int active;
+    int raw; // started at an access point rather than at a gzip header
+    off_t in;
+    off_t out;
+    char *recent; // the output of the last read, which ends at `out`
+    size_t recent_len;
+    unsigned char input[CHUNK];
+    char scratch[CHUNK];
+} gzindexState;
+
+static gzindexState G;
+
+int gzindexIsGzip(int fd) {
+    unsigned char magic[2];
+    return pread(fd, magic, 2, 0) == 2 && magic[0] == 0x1f &&
+           magic[1] == 0x8b;
+}
+
+int gzindexOpen(int fd) {
+    G.fd = fd;
+    G.active = 0;
+    G.recent = malloc(RECENT);
+    pthread_mutex_init(&G.lock, NULL);
+    return 0;
+}
+
+// `left` is the unused space at the end of the circular output window.
+static void gzindexAddPoint(int bits, off_t in, off_t out, unsigned left,
+                            unsigned char *window) {
+    gzindexPoint *p = malloc(sizeof(gzindexPoint));
+    p->out = out;
+    p->in = in;
+    p->bits = bits;
+    if (left)
+        memcpy(p->window, window + WINSIZE - left, left);
+    if (left < WINSIZE)
+        memcpy(p->window + left, window, WINSIZE - left);
+    pthread_mutex_lock(&G.lock);
+    if (G.npoints == G.cappoints) {
+        G.cappoints = G.cappoints ? G.cappoints * 2 : 16;
+        G.point = realloc(G.point, sizeof(gzindexPoint *) * G.cappoints);
+    }
+    G.point[G.npoints++] = p;
+    pthread_mutex_unlock(&G.lock);
+}
+
+off_t gzindexBuild(void (*fn)(const char *buf, size_t len, off_t off,
+                              void *arg),
+                   void *arg) {
+    z_stream strm;
+    memset(&strm, 0, sizeof(strm));
+    if (inflateInit2(&strm, 47) != Z_OK) // zlib or gzip header
+        return -1;
+    unsigned char *input = malloc(CHUNK);
+    unsigned char *window = calloc(1, WINSIZE);
+    off_t in = 0, totin = 0, totout = 0, last = 0;
+    int members = 0, ret = Z_OK;
+    for (;;) {
+        if (strm.avail_in == 0) {
+            ssize_t n = pread(G.fd, input, CHUNK, in);
+            if (n <= 0)
+                break;
+            in += n;
+            strm.next_in = input;
+            strm.avail_in = n;
+        }
+        if (strm.avail_out == 0) {
+            strm.next_out = window;
+            strm.avail_out = WINSIZE;
+        }
+        unsigned char *start = strm.next_out;
+        totin += strm.avail_in;
+        totout += strm.avail_out;
+        // Z_BLOCK stops at every deflate block boundary
+        ret = inflate(&strm, Z_BLOCK);
+        totin -= strm.avail_in;
+        totout -= strm.avail_out;
+        size_t produced = strm.next_out - start;
+        if (produced)
+            fn((char *)start, produced, totout - produced, arg);
+        if (ret == Z_STREAM_END) {
+            members++;
+            inflateReset(&strm); // another member may follow
+            continue;
+        }
+        if (ret != Z_OK && ret != Z_BUF_ERROR)
+            break;
+        if ((strm.data_type & 128) && !(strm.data_type & 64) &&
+            (totout == 0 || totout - last > GZINDEX_SPAN)) {
+            gzindexAddPoint(strm.data_type & 7, totin, totout,
+                            strm.avail_out, window);
+            last = totout;
+        }
+    }
+    inflateEnd(&strm);
+    free(input);
+    free(window);
+    // like gzip, ignore whatever follows the last complete member
+    if (ret != Z_OK && ret != Z_BUF_ERROR && ret != Z_STREAM_END &&
+        members == 0)
+        return -1;
+    return totout;
+}
+
+// Restarts the cursor at access point `p`, or at the start of the file.
+static int gzindexStart(gzindexPoint *p) {
+    if (G.active)
+        inflateEnd(&G.strm);
+    G.active = 0;
+    memset(&G.strm, 0, sizeof(G.strm));
+    if (inflateInit2(&G.strm, p ? -15 : 47) != Z_OK)
+        return -1;
+    G.active = 1;
+    G.recent_len = 0;
+    G.raw = p != NULL;
+    G.in = p ? p->in : 0;
+    G.out = p ? p->out : 0;
+    if (p && p->bits) {
+        unsigned char c;
+        if (pread(G.fd, &c, 1, p->in - 1) != 1)
+            return -1;
+        inflatePrime(&G.strm, p->bits, c >> (8 - p->bits));
+    }
+    if (p)
+        inflateSetDictionary(&G.strm, p->window, WINSIZE);
+    return 0;
+}
+
+// Inflates up to `len` bytes from the cursor into `buf`.
+static size_t gzindexInflate(char *buf, size_t len) {
+    if (!G.active)
+        return 0;
+    G.strm.next_out = (unsigned char *)buf;
+    G.strm.avail_out = len;
+    while (G.strm.avail_out > 0) {
+        if (G.strm.avail_in == 0) {
+            ssize_t n = pread(G.fd, G.input, CHUNK, G.in);
+            if (n <= 0)
+                break;
+            G.in += n;
+            G.strm.next_in = G.input;
+            G.strm.avail_in = n;
+        }
+        int ret = inflate(&G.strm, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) {
+            // A raw stream stops before the 8 byte gzip trailer, which has
+            // to be skipped by hand before the next member's header.
+            if (G.raw) {
+                unsigned skip = G.strm.avail_in < 8 ? G.strm.avail_in : 8;
+                G.in += 8 - skip;
+                G.strm.next_in += skip;
+                G.strm.avail_in -= skip;
+                G.raw = 0;
+            }
+            if (inflateReset2(&G.strm, 47) != Z_OK)
+                break;
+            continue;
+        }
+        if (ret != Z_OK) {
+            inflateEnd(&G.strm); // don't resume a broken stream
+            G.active = 0;
+            break;
+        }
+    }
+    size_t produced = len - G.strm.avail_out;
+    G.out += produced;
+    return produced;
+}
+
+ssize_t gzindexRead(char *buf, size_t len, off_t off) {
+    // Reads that back up a little, like a pager going back to the start of
+    // a line cut off at the end of the previous read, are served from what
+    // that read produced instead of inflating from an access point again.
+    size_t done = 0;
+    if (G.active && off < G.out && G.out - off <= (off_t)G.recent_len) {
+        done = G.out - off < (off_t)len ? (size_t)(G.out - off) : len;
+        memcpy(buf, G.recent + G.recent_len - (G.out - off), done);
+        if (done == len)
+            return len;
+        off += done;
+    }
+    pthread_mutex_lock(&G.lock);
+    int lo = 0, hi = G.npoints - 1;
+    gzindexPoint *p = NULL;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (G.point[mid]->out <= off) {
+            p = G.point[mid];
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    pthread_mutex_unlock(&G.lock);
+    // Carry on from the cursor when it is already between that point and
+    // `off`, which is the case for a sequential read.
+    if (!G.active || G.out > off || (p && p->out > G.out))
+        if (gzindexStart(p) == -1)
+            return -1;
+    // what the last read produced no longer ends at the cursor once it moves
+    if (G.out < off)
+        G.recent_len = 0;
+    while (G.out < off) {
+        size_t skip = off - G.out < CHUNK ? off - G.out : CHUNK;
+        if (gzindexInflate(G.scratch, skip) < skip)
+            return done;
+    }
+    size_t n = done + gzindexInflate(buf + done, len - done);
+    G.recent_len = n < RECENT ? n : RECENT;
+    memcpy(G.recent, buf + n - G.recent_len, G.recent_len);
+    return n;
+}
@@ -0,0 +1,30 @@
+#ifndef GZINDEX_H
+#define GZINDEX_H
+
+// Random access into a gzip file. While gzindexBuild() inflates the file
+// once from start to end, it records an access point every GZINDEX_SPAN
+// bytes of output: the input position of a deflate block boundary plus the
+// 32K of output before it, which is all inflate needs to resume there.
+// gzindexRead() then starts from the closest point instead of the start of
+// the file. This is the scheme of zlib's examples/zran.c.
+
+#include <sys/types.h>
+
+#define GZINDEX_SPAN (8 << 20)
+
+// Whether the file behind `fd` starts with the gzip magic bytes.
+int gzindexIsGzip(int fd);
+// Prepares random access to the gzip file behind `fd`.
+int gzindexOpen(int fd);
+// Inflates the whole file, handing each piece of output and its offset to
+// `fn`, and records access points on the way. May run on another thread
+// than gzindexRead(). Returns the size of the output, or -1 on a corrupt
+// file.
+off_t gzindexBuild(void (*fn)(const char *buf, size_t len, off_t off,
+                              void *arg),
+                   void *arg);
+// Reads up to `len` bytes of output at offset `off`. Returns less than
+// `len` only at the end of the output.
+ssize_t gzindexRead(char *buf, size_t len, off_t off);
+
+#endif
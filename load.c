@@ -0,0 +1,175 @@
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bracket.h"
+#include "complete.h"
+#include "editor.h"
+#include "load.h"
+#include "slab.h"
+#include "trace.h"
+
+#define LOAD_MAX_THREADS 64
+#define LOAD_MIN_BYTES (1 << 20) // bytes per thread worth starting one for
+
+typedef struct loadJob {
+    const char *start, *end; // whole lines, only the last chunk may end
+                             // without a newline
+    erow *rows;              // where the chunk's rows go in E.row
+    int nrows;
+    size_t bytes;
+    slabArena arena;
+    int started;
+    pthread_t thread;
+} loadJob;
+
+static void *loadCount(void *arg) {
+    loadJob *job = arg;
+    TRACE_BEGIN("loadCount");
+    int n = 0;
+    const char *p = job->start;
+    while (p < job->end && (p = memchr(p, '\n', job->end - p))) {
+        n++;
+        p++;
+    }
+    if (job->end > job->start && job->end[-1] != '\n')
+        n++;
+    job->nrows = n;
+    TRACE_END("loadCount");
+    return NULL;
+}
+
+// Builds the rows of a chunk. Only writes the chunk's own rows and arena,
+// so jobs need no locking.
+static void *loadBuild(void *arg) {
+    loadJob *job = arg;
+    TRACE_BEGIN("loadBuild");
+    int in_comment = 0;
+    const char *p = job->start;
+    for (int i = 0; i < job->nrows; i++) {
+        const char *nl = memchr(p, '\n', job->end - p);
+        size_t len = (nl ? nl : job->end) - p;
+        while (len > 0 && p[len - 1] == '\r')
+            len--;
+        erow *row = &job->rows[i];
+        row->size = len;
+        row->chars = slabArenaAlloc(&job->arena, len + 1);
+        memcpy(row->chars, p, len);
+        row->chars[len] = '\0';
+        row->rsize = 0;
+        row->render = NULL;
+        row->hl = NULL;
+        in_comment = editorLexRow(row, in_comment);
+        row->hl_open_comment = in_comment;
+        row->stamp = 0;
+        job->bytes += len + 1;
+        p = nl ? nl + 1 : job->end;
+    }
+    TRACE_END("loadBuild");
+    return NULL;
+}
+
+// Runs `fn` on every job, the first one on the calling thread.
+static void loadRun(loadJob *jobs, int njobs, void *(*fn)(void *)) {
+    for (int t = 1; t < njobs; t++) {
+        jobs[t].started =
+            pthread_create(&jobs[t].thread, NULL, fn, &jobs[t]) == 0;
+        if (!jobs[t].started)
+            fn(&jobs[t]);
+    }
+    fn(&jobs[0]);
+    for (int t = 1; t < njobs; t++)
+        if (jobs[t].started)
+            pthread_join(jobs[t].thread, NULL);
+}
+
+void loadText(const char *text, size_t len) {
+    if (len == 0)
+        return;
+    TRACE_BEGIN("loadText");
+    long nthreads = E.load_threads;
+    if (nthreads == 0) {
+        nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+        if ((size_t)nthreads > len / LOAD_MIN_BYTES)
+            nthreads = len / LOAD_MIN_BYTES;
+    }
+    if (nthreads > LOAD_MAX_THREADS)
+        nthreads = LOAD_MAX_THREADS;
+    if (nthreads < 1)
+        nthreads = 1;
+
+    loadJob jobs[LOAD_MAX_THREADS];
+    const char *end = text + len, *p = text;
+    for (int t = 0; t < nthreads; t++) {
+        const char *stop = text + len / nthreads * (t + 1);
+        if (t == nthreads - 1 || stop <= p) {
+            stop = t == nthreads - 1 ? end : p;
+        } else {
+            const char *nl = memchr(stop - 1, '\n', end - stop + 1);
+            stop = nl ? nl + 1 : end;
+        }
+        memset(&jobs[t], 0, sizeof(jobs[t]));
+        jobs[t].start = p;
+        jobs[t].end = stop;
+        p = stop;
+    }
+    loadRun(jobs, nthreads, loadCount);
+
+    int total = 0;
+    for (int t = 0; t < nthreads; t++)
+        total += jobs[t].nrows;
+    editorReserveRows(E.numrows + total);
+    int at = E.numrows;
+    for (int t = 0; t < nthreads; t++) {
+        jobs[t].rows = &E.row[at];
+        at += jobs[t].nrows;
+    }
+    loadRun(jobs, nthreads, loadBuild);
+
+    // Each chunk was lexed as if it started outside of a comment. Where that
+    // was wrong, redo its rows until the state at the end of one agrees with
+    // what the worker found.
+    int in_comment = E.numrows > 0 && E.row[E.numrows - 1].hl_open_comment;
+    for (int t = 0; t < nthreads; t++) {
+        int wrong = in_comment;
+        for (int i = 0; wrong && i < jobs[t].nrows; i++) {
+            erow *row = &jobs[t].rows[i];
+            in_comment = editorLexRow(row, in_comment);
+            wrong = in_comment != row->hl_open_comment;
+            row->hl_open_comment = in_comment;
+        }
+        if (jobs[t].nrows > 0)
+            in_comment = jobs[t].rows[jobs[t].nrows - 1].hl_open_comment;
+        E.stats.chars_bytes += jobs[t].bytes;
+        slabArenaClose(&jobs[t].arena);
+    }
+    for (int i = E.numrows; i < at; i++) {
+        E.row[i].idx = i;
+        completeRowAdd(&E.row[i]);
+    }
+    bracketRowsMoved(E.numrows);
+    E.numrows = at;
+    TRACE_END("loadText");
+}
+
+int loadFile(int fd) {
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode))
+        return -1;
+    if (st.st_size == 0)
+        return 0;
+    char *text = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (text == MAP_FAILED)
+        return -1;
+    madvise(text, st.st_size, MADV_SEQUENTIAL);
+    loadText(text, st.st_size);
+    munmap(text, st.st_size);
+    return 0;
+}
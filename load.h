@@ -0,0 +1,19 @@
+#ifndef LOAD_H
+#define LOAD_H
+
+// Parallel loading. The text is cut into one chunk per core at newline
+// boundaries, or into E.load_threads chunks when that is set; worker threads
+// count, then build the rows of their chunks and track multiline comments
+// and brackets as if each chunk started outside of a comment. A final pass
+// fixes that up across chunk boundaries. Rows are left unrendered,
+// editorRowTouch() renders and highlights them when shown.
+
+#include <stddef.h>
+
+// Appends the lines of `text` to the buffer. A last line without a newline
+// is kept too.
+void loadText(const char *text, size_t len);
+// Loads a regular file by mapping it. Returns -1 if it can't be mapped.
+int loadFile(int fd);
+
+#endif
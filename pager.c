@@ -0,0 +1,674 @@
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "editor.h"
+#include "gzindex.h"
+#include "pager.h"
+#include "slab.h"
+#include "trace.h"
+
+#define PAGER_SCAN_BYTES (1 << 20)   // what the indexer reads at a time
+#define PAGER_WINDOW_BYTES (1 << 20) // lines longer than this are cut short
+#define PAGER_NOTIFY_MS 100
+#define PAGER_SIZE_UNKNOWN ((off_t)1 << 62)
+#define ONES 0x0101010101010101ULL
+#define PAGER_CACHE_MAGIC "kiloidx1"
+#define PAGER_CACHE_EDGE (64 << 10) // hashed at both ends of the file
+#define PAGER_CACHE_SAMPLES 16      // 4K samples hashed in between
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+typedef struct pagerState {
+    int fd;
+    int gz;      // the file is gzip compressed, offsets are into its output
+    off_t size;  // PAGER_SIZE_UNKNOWN for gzip until the end is reached
+    struct stat st;
+    int lex;     // the syntax has multiline comments, track them per line
+    char *cache; // the sidecar file of the index, NULL if not caching
+    uint64_t hash; // pagerFingerprint() of the file
+    int event;
+    pthread_t indexer;
+    // Shared with the indexer, guarded by lock.
+    pthread_mutex_t lock;
+    off_t *index; // index[k] = offset of line k * PAGER_INDEX_STRIDE
+    unsigned char *comment; // comment[k] = in a comment at index[k]
+    int nindex;
+    int capindex;
+    int lines; // lines counted so far
+    int done;
+    off_t total; // size of the content once done, -1 if it is corrupt
+    // Main thread only.
+    int seen;      // lines known to exist from seeks past the index
+    int near_line; // the last seek, so scrolling only walks a few lines
+    off_t near_off;
+    int near_comment;
+    int far_line; // where the last long seek past the index stopped skipping
+    off_t far_off;
+    int far_comment;
+    char *window; // file bytes at [window_off, window_off + window_len)
+    off_t window_off;
+    size_t window_len;
+    erow *rows; // the lines on screen
+    int top;
+    int nrows;
+    int caprows;
+} pagerState;
+
+static pagerState P;
+
+// INDEXER
+
+static void pagerNotify() {
+    uint64_t one = 1;
+    write(P.event, &one, sizeof(one));
+}
+
+static void pagerCheckpoint(off_t off, int in_comment) {
+    pthread_mutex_lock(&P.lock);
+    if (P.nindex == P.capindex) {
+        P.capindex *= 2;
+        P.index = realloc(P.index, sizeof(off_t) * P.capindex);
+        P.comment = realloc(P.comment, P.capindex);
+    }
+    P.comment[P.nindex] = in_comment;
+    P.index[P.nindex++] = off;
+    pthread_mutex_unlock(&P.lock);
+}
+
+// Sets the low bit of every byte of `w` that is a '\n'. Unlike the usual
+// haszero() trick there are no false positives, so the bits can be counted.
+static uint64_t pagerNewlines(uint64_t w) {
+    uint64_t x = w ^ (ONES * '\n');
+    uint64_t y = (x & ONES * 0x7f) + ONES * 0x7f;
+    return ~(y | x | ONES * 0x7f) >> 7;
+}
+
+// Adds up the per-byte bits of pagerNewlines() in the top byte. Cheaper than
+// a popcount call on targets built without a popcount instruction.
+static int pagerBits(uint64_t nl) { return (nl * ONES) >> 56; }
+
+static int pagerCount(const char *buf, size_t len) {
+    int lines = 0;
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t w;
+        memcpy(&w, buf + i, 8);
+        lines += pagerBits(pagerNewlines(w));
+    }
+    for (; i < len; i++)
+        lines += buf[i] == '\n';
+    return lines;
+}
+
+// Counts the newlines of a block that starts at file offset `base`, eight
+// bytes at a time. Only a word that completes a stride is looked at byte by
+// byte, to record where the next checkpoint line starts.
+static int pagerScan(const char *buf, size_t len, off_t base, int lines) {
+    size_t i = 0;
+    for (; i + 8 <= len; i += 8) {
+        uint64_t w;
+        memcpy(&w, buf + i, 8);
+        uint64_t nl = pagerNewlines(w);
+        if (nl == 0)
+            continue;
+        int n = pagerBits(nl);
+        if (lines % PAGER_INDEX_STRIDE + n < PAGER_INDEX_STRIDE) {
+            lines += n;
+            continue;
+        }
+        for (int j = 0; j < 8; j++)
+            if (buf[i + j] == '\n' && ++lines % PAGER_INDEX_STRIDE == 0)
+                pagerCheckpoint(base + i + j + 1, 0);
+    }
+    for (; i < len; i++)
+        if (buf[i] == '\n' && ++lines % PAGER_INDEX_STRIDE == 0)
+            pagerCheckpoint(base + i + 1, 0);
+    return lines;
+}
+
+// Counts the lines of `buf`, which ends with a newline, and carries the
+// multiline comment state through them.
+static int pagerCountLex(const char *buf, size_t len, int *in_comment) {
+    int lines = 0;
+    const char *end = buf + len, *nl;
+    for (const char *p = buf; p < end; p = nl + 1) {
+        nl = memchr(p, '\n', end - p);
+        *in_comment = editorCommentState(p, nl - p, *in_comment);
+        lines++;
+    }
+    return lines;
+}
+
+typedef struct pagerProgress {
+    int lines;
+    char last;
+    double notified;
+    int in_comment;
+    char *carry; // the start of a line that goes on in the next block
+    size_t carry_len;
+} pagerProgress;
+
+// pagerScan() for a syntax with multiline comments: every line goes through
+// editorCommentState(), so that each checkpoint knows whether it starts in
+// a comment. Lines are cut at PAGER_WINDOW_BYTES like on screen.
+static void pagerLex(pagerProgress *pr, const char *buf, size_t len,
+                     off_t base) {
+    const char *end = buf + len, *nl;
+    for (const char *p = buf; p < end; p = nl + 1) {
+        nl = memchr(p, '\n', end - p);
+        const char *line = p;
+        size_t n = (nl ? nl : end) - p;
+        if (pr->carry_len > 0 || nl == NULL) {
+            size_t room = PAGER_WINDOW_BYTES - pr->carry_len;
+            memcpy(pr->carry + pr->carry_len, p, n < room ? n : room);
+            pr->carry_len += n < room ? n : room;
+            line = pr->carry;
+            n = pr->carry_len;
+        }
+        if (nl == NULL)
+            break;
+        if (n > PAGER_WINDOW_BYTES)
+            n = PAGER_WINDOW_BYTES;
+        pr->in_comment = editorCommentState(line, n, pr->in_comment);
+        pr->carry_len = 0;
+        if (++pr->lines % PAGER_INDEX_STRIDE == 0)
+            pagerCheckpoint(base + (nl - buf) + 1, pr->in_comment);
+    }
+}
+
+// Counts the lines of the next block of the file and publishes them.
+static void pagerIndexBlock(const char *buf, size_t len, off_t off,
+                            void *arg) {
+    pagerProgress *pr = arg;
+    TRACE_BEGIN("pagerIndex");
+    if (P.lex)
+        pagerLex(pr, buf, len, off);
+    else
+        pr->lines = pagerScan(buf, len, off, pr->lines);
+    pr->last = buf[len - 1];
+    TRACE_END("pagerIndex");
+    pthread_mutex_lock(&P.lock);
+    P.lines = pr->lines;
+    pthread_mutex_unlock(&P.lock);
+    if (editorNowMs() - pr->notified >= PAGER_NOTIFY_MS) {
+        pagerNotify();
+        pr->notified = editorNowMs();
+    }
+}
+
+static void pagerCacheSave(void);
+
+static void *pagerIndexer(void *arg) {
+    (void)arg;
+    pagerProgress pr = {0, '\n', editorNowMs(), 0, NULL, 0};
+    if (P.lex)
+        pr.carry = malloc(PAGER_WINDOW_BYTES);
+    off_t size = 0;
+    if (P.gz) {
+        size = gzindexBuild(pagerIndexBlock, &pr);
+    } else {
+        char *buf = malloc(PAGER_SCAN_BYTES);
+        ssize_t n;
+        while ((n = pread(P.fd, buf, PAGER_SCAN_BYTES, size)) > 0) {
+            pagerIndexBlock(buf, n, size, &pr);
+            size += n;
+        }
+        free(buf);
+    }
+    pthread_mutex_lock(&P.lock);
+    P.lines = pr.lines + (pr.last != '\n');
+    P.total = size;
+    P.done = 1;
+    pthread_mutex_unlock(&P.lock);
+    free(pr.carry);
+    if (P.cache)
+        pagerCacheSave();
+    pagerNotify();
+    return NULL;
+}
+
+// SIDECAR CACHE
+//
+// With a cache directory, the finished index of a plain file and the
+// comment state at each checkpoint are saved to DIR/<hash of the path>.idx.
+// Opening the file again maps that instead of indexing it. The sidecar is
+// only trusted if the file's size, mtime and a sampled hash of its content
+// match, and it was made with the same comment rules; otherwise it is
+// deleted and the file indexed from scratch.
+
+typedef struct pagerCacheHeader {
+    char magic[8];
+    uint32_t stride;
+    uint32_t offset_bytes;
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t hash;
+    uint64_t syntax; // pagerSyntaxKey()
+    int64_t lines;
+    int64_t nindex;
+    // followed by off_t index[nindex] and unsigned char comment[nindex]
+} pagerCacheHeader;
+
+static uint64_t pagerHash(uint64_t h, const void *buf, size_t len) {
+    const unsigned char *p = buf;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ p[i]) * FNV_PRIME;
+    return h;
+}
+
+// Hashes both ends of the file and samples spread in between. Costs the
+// same for any size, and still notices an edit that kept size and mtime
+// unless it happened to miss every sample.
+static uint64_t pagerFingerprint(void) {
+    char *buf = malloc(PAGER_CACHE_EDGE);
+    off_t size = P.st.st_size;
+    uint64_t h = pagerHash(FNV_OFFSET, &size, sizeof(size));
+    for (int i = 0; i <= PAGER_CACHE_SAMPLES + 1; i++) {
+        off_t off = size / (PAGER_CACHE_SAMPLES + 1) * i;
+        size_t len = 4096;
+        if (i == 0 || i == PAGER_CACHE_SAMPLES + 1) {
+            off = i ? size - PAGER_CACHE_EDGE : 0;
+            len = PAGER_CACHE_EDGE;
+        }
+        ssize_t n = pread(P.fd, buf, len, off < 0 ? 0 : off);
+        if (n > 0)
+            h = pagerHash(h, buf, n);
+    }
+    free(buf);
+    return h;
+}
+
+// Identifies the rules the comment states were computed with.
+static uint64_t pagerSyntaxKey(void) {
+    if (!P.lex)
+        return 0;
+    struct editorSyntax *syntax = E.syntax;
+    char *scs = syntax->single_line_comment ? syntax->single_line_comment
+                                            : "";
+    uint64_t h = FNV_OFFSET;
+    h = pagerHash(h, scs, strlen(scs) + 1);
+    h = pagerHash(h, syntax->multiline_comment_start,
+                  strlen(syntax->multiline_comment_start) + 1);
+    h = pagerHash(h, syntax->multiline_comment_end,
+                  strlen(syntax->multiline_comment_end) + 1);
+    return h ^ (syntax->flags & HL_HIGHLIGHT_STRINGS);
+}
+
+static int pagerCacheValid(const pagerCacheHeader *h, size_t len) {
+    size_t entry = sizeof(off_t) + 1;
+    if (memcmp(h->magic, PAGER_CACHE_MAGIC, 8) ||
+        h->stride != PAGER_INDEX_STRIDE || h->offset_bytes != sizeof(off_t) ||
+        h->size != (uint64_t)P.st.st_size ||
+        h->mtime_sec != P.st.st_mtim.tv_sec ||
+        h->mtime_nsec != P.st.st_mtim.tv_nsec ||
+        h->syntax != pagerSyntaxKey() || h->lines < 0 ||
+        h->lines > INT_MAX || h->nindex < 1 ||
+        h->nindex - 1 > h->lines / PAGER_INDEX_STRIDE ||
+        (uint64_t)h->nindex != (len - sizeof(*h)) / entry ||
+        len != sizeof(*h) + h->nindex * entry)
+        return 0;
+    const off_t *index = (const off_t *)(h + 1);
+    const unsigned char *comment = (const unsigned char *)(index + h->nindex);
+    if (index[0] != 0 || comment[0] != 0)
+        return 0;
+    for (int64_t k = 1; k < h->nindex; k++)
+        if (index[k] <= index[k - 1] || index[k] > P.st.st_size ||
+            comment[k] > 1)
+            return 0;
+    return h->hash == P.hash;
+}
+
+// Takes the index from the sidecar if there is a valid one.
+static int pagerCacheLoad(void) {
+    int fd = open(P.cache, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return 0;
+    TRACE_BEGIN("pagerCacheLoad");
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(pagerCacheHeader))
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    int valid = map != MAP_FAILED && pagerCacheValid(map, st.st_size);
+    if (valid) {
+        pagerCacheHeader *h = map;
+        P.index = (off_t *)(h + 1);
+        P.comment = (unsigned char *)(P.index + h->nindex);
+        P.nindex = P.capindex = h->nindex;
+        P.lines = h->lines;
+        P.total = h->size;
+        P.done = 1;
+    } else {
+        if (map != MAP_FAILED)
+            munmap(map, st.st_size);
+        unlink(P.cache);
+    }
+    TRACE_END("pagerCacheLoad");
+    return valid;
+}
+
+static int pagerWriteAll(int fd, const void *buf, size_t len) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n == -1 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return 0;
+        p += n;
+        len -= n;
+    }
+    return 1;
+}
+
+// Writes the sidecar once the indexer is done, unless the file changed in
+// the meantime. Goes through a temporary file, so that a reader never maps
+// a half written one.
+static void pagerCacheSave(void) {
+    struct stat st;
+    if (P.total != P.st.st_size || fstat(P.fd, &st) == -1 ||
+        st.st_size != P.st.st_size ||
+        st.st_mtim.tv_sec != P.st.st_mtim.tv_sec ||
+        st.st_mtim.tv_nsec != P.st.st_mtim.tv_nsec)
+        return;
+    pagerCacheHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, PAGER_CACHE_MAGIC, 8);
+    h.stride = PAGER_INDEX_STRIDE;
+    h.offset_bytes = sizeof(off_t);
+    h.size = P.st.st_size;
+    h.mtime_sec = P.st.st_mtim.tv_sec;
+    h.mtime_nsec = P.st.st_mtim.tv_nsec;
+    h.hash = P.hash;
+    h.syntax = pagerSyntaxKey();
+    h.lines = P.lines;
+    h.nindex = P.nindex;
+    char tmp[PATH_MAX];
+    snprintf(tmp, sizeof(tmp), "%s.%d", P.cache, (int)getpid());
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd == -1)
+        return;
+    int ok = pagerWriteAll(fd, &h, sizeof(h)) &&
+             pagerWriteAll(fd, P.index, sizeof(off_t) * P.nindex) &&
+             pagerWriteAll(fd, P.comment, P.nindex);
+    if (close(fd) == -1)
+        ok = 0;
+    if (!ok || rename(tmp, P.cache) == -1)
+        unlink(tmp);
+}
+
+// Picks the sidecar path for `filename` in `dir`, creating `dir` if needed.
+static void pagerCacheOpen(const char *filename, const char *dir) {
+    char *path = realpath(filename, NULL);
+    const char *key = path ? path : filename;
+    uint64_t h = pagerHash(FNV_OFFSET, key, strlen(key));
+    free(path);
+    if (mkdir(dir, 0700) == -1 && errno != EEXIST)
+        return;
+    P.cache = malloc(strlen(dir) + 22);
+    sprintf(P.cache, "%s/%016llx.idx", dir, (unsigned long long)h);
+    P.hash = pagerFingerprint();
+}
+
+int pagerOpen(const char *filename, const char *cachedir) {
+    P.fd = open(filename, O_RDONLY);
+    if (P.fd == -1 || fstat(P.fd, &P.st) == -1)
+        return -1;
+    P.gz = gzindexIsGzip(P.fd);
+    P.size = P.gz ? PAGER_SIZE_UNKNOWN : P.st.st_size;
+    if (P.gz)
+        gzindexOpen(P.fd);
+    P.event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (P.event == -1)
+        return -1;
+    pthread_mutex_init(&P.lock, NULL);
+    free(E.filename);
+    E.filename = strdup(filename);
+    editorSelectSyntaxHighlight(); // the indexer needs it for P.lex
+    E.pager = 1;
+    P.lex = E.syntax && E.syntax->multiline_comment_start &&
+            *E.syntax->multiline_comment_start &&
+            E.syntax->multiline_comment_end &&
+            *E.syntax->multiline_comment_end;
+    P.window = malloc(PAGER_WINDOW_BYTES);
+    // gzip files are not cached, their access points would be needed too
+    if (cachedir && *cachedir && !P.gz) {
+        pagerCacheOpen(filename, cachedir);
+        if (P.cache && pagerCacheLoad())
+            return P.event;
+    }
+    P.capindex = 64;
+    P.index = malloc(sizeof(off_t) * P.capindex);
+    P.comment = malloc(P.capindex);
+    P.index[0] = 0;
+    P.comment[0] = 0;
+    P.nindex = 1;
+    if (pthread_create(&P.indexer, NULL, pagerIndexer, NULL) != 0)
+        return -1;
+    pthread_detach(P.indexer);
+    return P.event;
+}
+
+int pagerHandle(void) {
+    uint64_t n;
+    if (read(P.event, &n, sizeof(n)) != sizeof(n))
+        return 0;
+    return SOURCE_REDRAW;
+}
+
+// Takes over the size found by the indexer. Called with the lock held.
+static void pagerSyncSize() {
+    if (P.done && P.total >= 0)
+        P.size = P.total;
+}
+
+int pagerLineCount(int *complete) {
+    pthread_mutex_lock(&P.lock);
+    int lines = P.lines;
+    int done = P.done;
+    pagerSyncSize();
+    pthread_mutex_unlock(&P.lock);
+    if (complete)
+        *complete = done;
+    return done || lines > P.seen ? lines : P.seen;
+}
+
+// READING
+
+// Reads file content at `off`, inflated for a gzip file. A short read means
+// the end of the file, which is how the size of a gzip file becomes known
+// before the indexer is done.
+static ssize_t pagerRead(char *buf, size_t len, off_t off) {
+    ssize_t n =
+        P.gz ? gzindexRead(buf, len, off) : pread(P.fd, buf, len, off);
+    if (n >= 0 && (size_t)n < len && off + n < P.size)
+        P.size = off + n;
+    return n;
+}
+
+// Returns the offset just past the newline that ends the line running
+// through `off`, or the end of the file.
+static off_t pagerSkipLine(off_t off) {
+    char buf[16384];
+    ssize_t n;
+    while ((n = pagerRead(buf, sizeof(buf), off)) > 0) {
+        char *nl = memchr(buf, '\n', n);
+        if (nl)
+            return off + (nl - buf) + 1;
+        off += n;
+    }
+    return off;
+}
+
+// Stores the line starting at *off in *line and *len and moves *off to the
+// start of the next one. The bytes live in P.window and stay valid until the
+// next call. Returns 0 at the end of the file.
+static int pagerReadLine(off_t *off, char **line, size_t *len) {
+    if (*off >= P.size)
+        return 0;
+    for (int reloaded = 0;; reloaded = 1) {
+        off_t end = P.window_off + (off_t)P.window_len;
+        if (*off >= P.window_off && *off < end) {
+            char *start = P.window + (*off - P.window_off);
+            size_t avail = end - *off;
+            char *nl = memchr(start, '\n', avail);
+            if (nl || end >= P.size || reloaded) {
+                *line = start;
+                *len = nl ? (size_t)(nl - start) : avail;
+                if (nl)
+                    *off += *len + 1;
+                else
+                    *off = end >= P.size ? P.size : pagerSkipLine(end);
+                return 1;
+            }
+        }
+        if (reloaded)
+            return 0;
+        ssize_t n = pagerRead(P.window, PAGER_WINDOW_BYTES, *off);
+        if (n <= 0) {
+            P.window_len = 0;
+            return 0;
+        }
+        P.window_off = *off;
+        P.window_len = n;
+    }
+}
+
+// Walks to line `line` from the closest known line start before it: a
+// checkpoint, or one of the positions remembered from earlier seeks. Returns
+// the line reached, which is the last line when the file is shorter, and
+// stores its offset in *off and whether it starts in a comment in
+// *in_comment.
+static int pagerSeek(int line, off_t *off, int *in_comment) {
+    pthread_mutex_lock(&P.lock);
+    pagerSyncSize();
+    int k = line / PAGER_INDEX_STRIDE;
+    if (k >= P.nindex)
+        k = P.nindex - 1;
+    if (k > 0 && P.index[k] >= P.size) // the file ends with that newline
+        k--;
+    *off = P.index[k];
+    *in_comment = P.comment[k];
+    pthread_mutex_unlock(&P.lock);
+    int at = k * PAGER_INDEX_STRIDE;
+    if (P.near_line <= line && P.near_line > at) {
+        at = P.near_line;
+        *off = P.near_off;
+        *in_comment = P.near_comment;
+    }
+    if (P.far_line <= line && P.far_line > at) {
+        at = P.far_line;
+        *off = P.far_off;
+        *in_comment = P.far_comment;
+    }
+    // Far past the index, skip whole windows by counting their newlines.
+    int skipped = 0;
+    while (line - at > PAGER_INDEX_STRIDE) {
+        ssize_t n = pagerRead(P.window, PAGER_WINDOW_BYTES, *off);
+        P.window_off = *off;
+        P.window_len = n > 0 ? n : 0;
+        char *last = n > 0 ? memrchr(P.window, '\n', n) : NULL;
+        if (last == NULL || *off + (last - P.window) + 1 >= P.size)
+            break;
+        int comment = *in_comment;
+        int count = P.lex ? pagerCountLex(P.window, last - P.window + 1,
+                                          &comment)
+                          : pagerCount(P.window, last - P.window + 1);
+        if (at + count > line)
+            break;
+        at += count;
+        *off += last - P.window + 1;
+        *in_comment = comment;
+        skipped = 1;
+    }
+    if (skipped) {
+        P.far_line = at;
+        P.far_off = *off;
+        P.far_comment = *in_comment;
+    }
+    while (at < line) {
+        off_t next = *off;
+        char *s;
+        size_t len;
+        if (!pagerReadLine(&next, &s, &len) || next >= P.size)
+            break;
+        if (P.lex)
+            *in_comment = editorCommentState(s, len, *in_comment);
+        at++;
+        *off = next;
+    }
+    P.near_line = at;
+    P.near_off = *off;
+    P.near_comment = *in_comment;
+    if (*off < P.size && at >= P.seen)
+        P.seen = at + 1;
+    return at;
+}
+
+int pagerSeekLine(int line) {
+    off_t off;
+    int in_comment;
+    return pagerSeek(line < 0 ? 0 : line, &off, &in_comment);
+}
+
+// Reads, renders and highlights the lines from E.rowoff down, starting with
+// the comment state pagerSeek() carried to the top line.
+static void pagerFill() {
+    for (int i = 0; i < P.nrows; i++)
+        editorFreeRow(&P.rows[i]);
+    if (P.caprows != E.screenRows) {
+        P.caprows = E.screenRows;
+        P.rows = realloc(P.rows, sizeof(erow) * P.caprows);
+    }
+    P.nrows = 0;
+    P.top = E.rowoff;
+    off_t off;
+    int in_comment;
+    if (pagerSeek(P.top, &off, &in_comment) != P.top)
+        return;
+    TRACE_BEGIN("pagerFill");
+    char *s;
+    size_t len;
+    while (P.nrows < P.caprows && pagerReadLine(&off, &s, &len)) {
+        if (len > 0 && s[len - 1] == '\r')
+            len--;
+        erow *row = &P.rows[P.nrows];
+        row->idx = P.top + P.nrows;
+        row->size = len;
+        row->chars = slabAlloc(len + 1);
+        memcpy(row->chars, s, len);
+        row->chars[len] = '\0';
+        E.stats.chars_bytes += len + 1;
+        row->render = NULL;
+        editorRenderRow(row);
+        row->hl = slabAlloc(row->rsize);
+        in_comment = editorHighlightRow(row, in_comment);
+        row->hl_open_comment = in_comment;
+        P.nrows++;
+    }
+    TRACE_END("pagerFill");
+}
+
+erow *pagerRow(int line) {
+    if (P.top != E.rowoff || P.caprows != E.screenRows || P.rows == NULL)
+        pagerFill();
+    int i = line - P.top;
+    if (i < 0 || i >= P.nrows)
+        return NULL;
+    return &P.rows[i];
+}
@@ -0,0 +1,29 @@
+#ifndef PAGER_H
+#define PAGER_H
+
+// Pager mode (-p): a read-only view of a file that may be far too big to
+// load. No erows exist for the file as a whole; a background thread counts
+// newlines and keeps the offset of every PAGER_INDEX_STRIDE-th line, along
+// with whether it starts inside a multiline comment, and only the lines on
+// screen are read and rendered.
+
+#include "editor.h"
+
+#define PAGER_INDEX_STRIDE 4096
+
+// Opens `filename`, starts indexing it and returns a descriptor that
+// becomes readable whenever the indexer has made progress, or -1. With a
+// `cachedir`, the index is kept there for the next time (see pager.c).
+int pagerOpen(const char *filename, const char *cachedir);
+// Source handler, returns SOURCE_* flags.
+int pagerHandle(void);
+// Returns line `line` of the file rendered and highlighted, or NULL past the
+// end. Valid until the view moves.
+erow *pagerRow(int line);
+// Returns `line`, or the last line of the file if it has fewer lines. Works
+// before indexing is done by walking forward from the last known offset.
+int pagerSeekLine(int line);
+// Lines known so far; *complete tells whether that is the whole file.
+int pagerLineCount(int *complete);
+
+#endif
@@ -0,0 +1,138 @@
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "complete.h"
+#include "editor.h"
+#include "replace.h"
+#include "slab.h"
+#include "trace.h"
+
+#define REPLACE_MAX_THREADS 16
+#define REPLACE_MIN_ROWS 4096 // rows per thread worth starting one for
+
+typedef struct replaceJob {
+    const char *query;
+    const char *with;
+    int from, to; // rows [from, to)
+    char **chars; // new contents of the rows, NULL when a row has no match
+    int *sizes;
+    long count;
+    int started;
+    pthread_t thread;
+} replaceJob;
+
+// Builds the replaced contents of the job's rows. Only reads E.row and only
+// writes the job's own slots of `chars`, so jobs need no locking. The new
+// rows come from malloc, as slab.c is not thread safe; slabFree() takes them.
+static void *replaceWorker(void *arg) {
+    replaceJob *job = arg;
+    TRACE_BEGIN("replaceWorker");
+    size_t qlen = strlen(job->query);
+    size_t wlen = strlen(job->with);
+    for (int i = job->from; i < job->to; i++) {
+        erow *row = &E.row[i];
+        int n = 0;
+        for (char *p = row->chars; (p = strstr(p, job->query)); p += qlen)
+            n++;
+        if (n == 0)
+            continue;
+        char *out = malloc(row->size - n * qlen + n * wlen + 1);
+        char *dst = out, *src = row->chars, *match;
+        while ((match = strstr(src, job->query))) {
+            memcpy(dst, src, match - src);
+            dst += match - src;
+            memcpy(dst, job->with, wlen);
+            dst += wlen;
+            src = match + qlen;
+        }
+        size_t rest = row->chars + row->size - src;
+        memcpy(dst, src, rest);
+        dst[rest] = '\0';
+        job->chars[i] = out;
+        job->sizes[i] = dst + rest - out;
+        job->count += n;
+    }
+    TRACE_END("replaceWorker");
+    return NULL;
+}
+
+long replaceAll(const char *query, const char *with) {
+    if (*query == '\0' || E.numrows == 0)
+        return 0;
+    TRACE_BEGIN("replaceAll");
+    int nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nthreads > REPLACE_MAX_THREADS)
+        nthreads = REPLACE_MAX_THREADS;
+    if (nthreads > E.numrows / REPLACE_MIN_ROWS)
+        nthreads = E.numrows / REPLACE_MIN_ROWS;
+    if (nthreads < 1)
+        nthreads = 1;
+
+    char **chars = calloc(E.numrows, sizeof(char *));
+    int *sizes = malloc(sizeof(int) * E.numrows);
+    replaceJob jobs[REPLACE_MAX_THREADS];
+    for (int t = 0; t < nthreads; t++) {
+        jobs[t].query = query;
+        jobs[t].with = with;
+        jobs[t].from = (long)E.numrows * t / nthreads;
+        jobs[t].to = (long)E.numrows * (t + 1) / nthreads;
+        jobs[t].chars = chars;
+        jobs[t].sizes = sizes;
+        jobs[t].count = 0;
+    }
+    // the main thread takes the first share itself
+    for (int t = 1; t < nthreads; t++) {
+        jobs[t].started = pthread_create(&jobs[t].thread, NULL,
+                                         replaceWorker, &jobs[t]) == 0;
+        if (!jobs[t].started)
+            replaceWorker(&jobs[t]);
+    }
+    replaceWorker(&jobs[0]);
+    long count = jobs[0].count;
+    for (int t = 1; t < nthreads; t++) {
+        if (jobs[t].started)
+            pthread_join(jobs[t].thread, NULL);
+        count += jobs[t].count;
+    }
+
+    // Swap the new contents in, then rebuild each run of touched rows in one
+    // pass. An untouched row is only rebuilt if a comment opened or closed
+    // above it changes its state. Such a change is carried no further than
+    // the next run, whose pass starts from the state it left.
+    int from = -1, to = -1; // the run waiting for its pass
+    for (int i = 0; i < E.numrows; i++) {
+        if (chars[i] == NULL)
+            continue;
+        int start = i;
+        for (; i < E.numrows && chars[i]; i++) {
+            erow *row = &E.row[i];
+            E.stats.chars_bytes += sizes[i] - row->size;
+            completeRowRemove(row);
+            slabFree(row->chars);
+            row->chars = chars[i];
+            row->size = sizes[i];
+            completeRowAdd(row);
+        }
+        if (to != -1)
+            editorUpdateRows(from, to, start);
+        from = start;
+        to = i - 1;
+    }
+    if (to != -1)
+        editorUpdateRows(from, to, E.numrows);
+    free(chars);
+    free(sizes);
+    if (count) {
+        E.dirty++;
+        if (E.cursorY < E.numrows && E.cursorX > E.row[E.cursorY].size)
+            E.cursorX = E.row[E.cursorY].size;
+    }
+    TRACE_END("replaceAll");
+    return count;
+}
@@ -0,0 +1,12 @@
+#ifndef REPLACE_H
+#define REPLACE_H
+
+// Replace-all as one batched edit: worker threads find the matches and
+// build the new rows, then the main thread swaps them in and re-highlights
+// each run of touched rows once.
+
+// Replaces every occurrence of `query` in the buffer with `with` and
+// returns how many there were.
+long replaceAll(const char *query, const char *with);
+
+#endif
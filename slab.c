@@ -0,0 +1,276 @@
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include "slab.h"
+
+#ifndef KILO_MALLOC_ROWS
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define SLAB_PAGE_SHIFT 20
+#define SLAB_PAGE ((size_t)1 << SLAB_PAGE_SHIFT)
+// Address space reserved up front, so that a pointer can be told to be ours
+// by its address alone. Only pages that get used are backed by memory.
+#define SLAB_REGION ((size_t)64 << 30)
+#define SLAB_PAGES (SLAB_REGION >> SLAB_PAGE_SHIFT)
+// 8 byte steps up to 64, then four classes per power of two up to SLAB_MAX
+#define SLAB_CLASSES 48
+#define SLAB_ARENA SLAB_CLASSES
+
+typedef struct slabPage {
+    char *free;  // freed blocks, each starting with a pointer to the next
+    size_t used; // bytes handed out so far from the start of the page
+    int cls;     // size class, or SLAB_ARENA
+    int live;    // blocks handed out and not freed yet
+    int open;    // an arena is still filling it
+    // the list of pages of the class that have room left
+    struct slabPage *prev, *next;
+} slabPage;
+
+static struct {
+    char *base;
+    int failed;
+    size_t npages;  // pages taken from the region so far
+    slabPage *pool; // released pages, linked through next
+    slabPage *avail[SLAB_CLASSES];
+    slabArena text; // what slabAllocText() fills
+    int arena_depth;
+    size_t held;
+    size_t idle;
+    slabPage page[SLAB_PAGES];
+} S;
+
+// Guards taking pages from the region and the pool, which threads filling
+// private arenas do.
+static pthread_mutex_t slabLock = PTHREAD_MUTEX_INITIALIZER;
+
+static int slabClass(size_t n) {
+    if (n <= 64)
+        return n ? (int)((n - 1) >> 3) : 0;
+    int shift = 6;
+    while ((n - 1) >> (shift + 1))
+        shift++;
+    return 8 + (shift - 6) * 4 + (int)(((n - 1) >> (shift - 2)) & 3);
+}
+
+static size_t slabSize(int cls) {
+    if (cls < 8)
+        return (size_t)(cls + 1) << 3;
+    int shift = 6 + (cls - 8) / 4;
+    return ((size_t)1 << shift) + ((size_t)((cls - 8) % 4 + 1) << (shift - 2));
+}
+
+static int slabInit(void) {
+    if (__atomic_load_n(&S.base, __ATOMIC_ACQUIRE))
+        return 1;
+    if (__atomic_load_n(&S.failed, __ATOMIC_RELAXED))
+        return 0;
+    pthread_mutex_lock(&slabLock);
+    if (S.base == NULL && !S.failed) {
+        char *p = mmap(NULL, SLAB_REGION + SLAB_PAGE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        uintptr_t aligned =
+            ((uintptr_t)p + SLAB_PAGE - 1) & ~(SLAB_PAGE - 1);
+        if (p == MAP_FAILED)
+            // everything goes to malloc
+            __atomic_store_n(&S.failed, 1, __ATOMIC_RELAXED);
+        else
+            __atomic_store_n(&S.base, (char *)aligned, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&slabLock);
+    return S.base != NULL;
+}
+
+static slabPage *slabPageOf(void *p) {
+    uintptr_t off = (uintptr_t)p - (uintptr_t)S.base;
+    if (S.base == NULL || off >= SLAB_REGION)
+        return NULL;
+    return &S.page[off >> SLAB_PAGE_SHIFT];
+}
+
+static char *slabPageAddr(slabPage *pg) {
+    return S.base + ((size_t)(pg - S.page) << SLAB_PAGE_SHIFT);
+}
+
+static int slabHasRoom(slabPage *pg) {
+    return pg->free || pg->used + slabSize(pg->cls) <= SLAB_PAGE;
+}
+
+static void slabLink(slabPage *pg) {
+    pg->prev = NULL;
+    pg->next = S.avail[pg->cls];
+    if (pg->next)
+        pg->next->prev = pg;
+    S.avail[pg->cls] = pg;
+}
+
+static void slabUnlink(slabPage *pg) {
+    if (pg->prev)
+        pg->prev->next = pg->next;
+    else
+        S.avail[pg->cls] = pg->next;
+    if (pg->next)
+        pg->next->prev = pg->prev;
+}
+
+static slabPage *slabNewPage(int cls) {
+    pthread_mutex_lock(&slabLock);
+    slabPage *pg = S.pool;
+    if (pg)
+        S.pool = pg->next;
+    else if (S.npages < SLAB_PAGES)
+        pg = &S.page[S.npages++];
+    pthread_mutex_unlock(&slabLock);
+    if (pg == NULL)
+        return NULL;
+    memset(pg, 0, sizeof(*pg));
+    pg->cls = cls;
+    return pg;
+}
+
+// Hands the memory of a page without live blocks back to the kernel.
+static void slabRelease(slabPage *pg) {
+    S.held -= pg->used;
+    if (pg->cls != SLAB_ARENA)
+        S.idle -= pg->used; // all of it is on the free list
+    madvise(slabPageAddr(pg), SLAB_PAGE, MADV_DONTNEED);
+    pthread_mutex_lock(&slabLock);
+    pg->next = S.pool;
+    S.pool = pg;
+    pthread_mutex_unlock(&slabLock);
+}
+
+void *slabAlloc(size_t n) {
+    if (n > SLAB_MAX || !slabInit())
+        return malloc(n);
+    int cls = slabClass(n);
+    size_t size = slabSize(cls);
+    slabPage *pg = S.avail[cls];
+    if (pg == NULL) {
+        if ((pg = slabNewPage(cls)) == NULL)
+            return malloc(n);
+        slabLink(pg);
+    }
+    char *p;
+    if (pg->free) {
+        p = pg->free;
+        memcpy(&pg->free, p, sizeof(char *));
+        S.idle -= size;
+    } else {
+        p = slabPageAddr(pg) + pg->used;
+        pg->used += size;
+        S.held += size;
+    }
+    pg->live++;
+    if (!slabHasRoom(pg))
+        slabUnlink(pg);
+    return p;
+}
+
+void *slabArenaAlloc(slabArena *arena, size_t n) {
+    slabPage *pg = arena->page;
+    if (pg == NULL || pg->used + n > SLAB_PAGE) {
+        slabPage *next = n <= SLAB_MAX && slabInit()
+                             ? slabNewPage(SLAB_ARENA)
+                             : NULL;
+        if (next == NULL)
+            return malloc(n);
+        next->open = 1;
+        if (pg) {
+            pg->open = 0;
+            // only possible for the main thread's arena, the blocks of the
+            // others aren't freed before they are closed
+            if (pg->live == 0)
+                slabRelease(pg);
+        }
+        arena->page = pg = next;
+    }
+    char *p = slabPageAddr(pg) + pg->used;
+    pg->used += n;
+    pg->live++;
+    arena->held += n;
+    return p;
+}
+
+void slabArenaClose(slabArena *arena) {
+    S.held += arena->held;
+    arena->held = 0;
+    if (arena->page) {
+        arena->page->open = 0;
+        if (arena->page->live == 0)
+            slabRelease(arena->page);
+        arena->page = NULL;
+    }
+}
+
+void *slabAllocText(size_t n) {
+    if (S.arena_depth == 0)
+        return slabAlloc(n);
+    void *p = slabArenaAlloc(&S.text, n);
+    S.held += S.text.held;
+    S.text.held = 0;
+    return p;
+}
+
+void *slabRealloc(void *p, size_t keep, size_t n) {
+    if (p == NULL)
+        return slabAlloc(n);
+    slabPage *pg = slabPageOf(p);
+    if (pg == NULL)
+        return realloc(p, n);
+    if (pg->cls != SLAB_ARENA) {
+        size_t size = slabSize(pg->cls);
+        // stay put unless the block would be mostly empty
+        if (n <= size && (n > size / 4 || size <= 64))
+            return p;
+    }
+    char *q = slabAlloc(n);
+    memcpy(q, p, keep < n ? keep : n);
+    slabFree(p);
+    return q;
+}
+
+void slabFree(void *p) {
+    slabPage *pg = slabPageOf(p);
+    if (pg == NULL) {
+        free(p);
+        return;
+    }
+    pg->live--;
+    if (pg->cls == SLAB_ARENA) {
+        if (pg->live == 0 && !pg->open)
+            slabRelease(pg);
+        return;
+    }
+    int full = !slabHasRoom(pg);
+    memcpy(p, &pg->free, sizeof(char *));
+    pg->free = p;
+    S.idle += slabSize(pg->cls);
+    if (full)
+        slabLink(pg);
+    // An empty page is kept if it is the only one of its class with room,
+    // so a row freed and allocated again doesn't go back to the kernel.
+    if (pg->live == 0 && (S.avail[pg->cls] != pg || pg->next)) {
+        slabUnlink(pg);
+        slabRelease(pg);
+    }
+}
+
+void slabArenaBegin(void) { S.arena_depth++; }
+
+void slabArenaEnd(void) { S.arena_depth--; }
+
+void slabStats(size_t *held, size_t *idle) {
+    *held = S.held;
+    *idle = S.idle;
+}
+
+#else
+
+typedef int slabUnused; // ISO C wants something in a translation unit
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+// Allocator for row buffers (chars, render, hl). Blocks up to SLAB_MAX bytes
+// come from 1MB pages that each serve a single size class, so a row costs no
+// malloc header and freed blocks are reused by the next row of that size.
+// While an arena is open (slabArenaBegin), row text is instead packed back
+// to back into arena pages, which is what loading a file does.
+//
+// Pointers that did not come from a page, like buffers built by other
+// threads or rows longer than SLAB_MAX, belong to malloc; slabFree() and
+// slabRealloc() tell them apart by address. Main thread only, except for
+// slabArenaAlloc().
+//
+// Building with -DKILO_MALLOC_ROWS turns all of it back into plain malloc,
+// the baseline to measure against.
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#define SLAB_MAX (64 << 10)
+
+// A private arena, which lets another thread pack text into pages of its
+// own, e.g. to build rows in parallel.
+typedef struct slabArena {
+    struct slabPage *page; // being filled
+    size_t held;           // not yet counted by slabStats()
+} slabArena;
+#define SLAB_ARENA_INIT {NULL, 0}
+
+#ifdef KILO_MALLOC_ROWS
+
+#define slabAlloc(n) malloc(n)
+#define slabAllocText(n) malloc(n)
+#define slabRealloc(p, keep, n) realloc(p, n)
+#define slabFree(p) free(p)
+#define slabArenaBegin()
+#define slabArenaEnd()
+#define slabArenaAlloc(arena, n) ((void)(arena), malloc(n))
+#define slabArenaClose(arena) ((void)(arena))
+#define slabStats(held, idle) (*(held) = 0, *(idle) = 0)
+
+#else
+
+void *slabAlloc(size_t n);
+// Like slabAlloc(), but packed into the open arena if there is one. Meant
+// for text that will rarely change size or be freed, as the space of a
+// freed arena block is only reclaimed with its whole page.
+void *slabAllocText(size_t n);
+// Resizes `p`, preserving its first `keep` bytes. Grows in place when the
+// block's size class has room.
+void *slabRealloc(void *p, size_t keep, size_t n);
+void slabFree(void *p);
+// Opens and closes the arena; calls nest.
+void slabArenaBegin(void);
+void slabArenaEnd(void);
+// Packs `n` bytes into `arena`. Threads may call this at the same time as
+// long as each uses its own arena and the main thread makes no other slab
+// call meanwhile.
+void *slabArenaAlloc(slabArena *arena, size_t n);
+// Hands a private arena's blocks over to the main thread, once the thread
+// that filled it is done.
+void slabArenaClose(slabArena *arena);
+// Bytes of pages in use, and how much of that sits on free lists.
+void slabStats(size_t *held, size_t *idle);
+
+#endif
+
+#endif
@@ -0,0 +1,130 @@
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "editor.h"
+#include "stream.h"
+#include "trace.h"
+
+#define STREAM_READ_BYTES (64 * 1024)
+// Upper bound on what one streamHandle() call appends, as in follow mode.
+#define STREAM_BATCH_BYTES (1 << 20)
+
+typedef struct streamState {
+    int fd;
+    int event;
+    pthread_t reader;
+    // Filled by the reader, guarded by lock.
+    pthread_mutex_t lock;
+    char *pending;
+    size_t len;
+    size_t cap;
+    int eof;
+    // Main thread only: the pending bytes taken over by the last swap.
+    char *taken;
+    size_t taken_len;
+    size_t taken_cap;
+    size_t consumed;
+    int ended; // the reader hit EOF before the last swap
+    int partial;
+    size_t total;
+} streamState;
+
+static streamState S;
+
+static void *streamReader(void *arg) {
+    (void)arg;
+    char buf[STREAM_READ_BYTES];
+    ssize_t n;
+    while ((n = read(S.fd, buf, sizeof(buf))) != 0) {
+        if (n == -1)
+            break; // treat a read error like the end of the input
+        pthread_mutex_lock(&S.lock);
+        int wake = S.len == 0;
+        if (S.len + n > S.cap) {
+            S.cap = S.cap ? S.cap * 2 : STREAM_READ_BYTES;
+            while (S.len + n > S.cap)
+                S.cap *= 2;
+            S.pending = realloc(S.pending, S.cap);
+        }
+        memcpy(S.pending + S.len, buf, n);
+        S.len += n;
+        pthread_mutex_unlock(&S.lock);
+        // one wakeup per batch, the main loop takes everything at once
+        if (wake) {
+            uint64_t one = 1;
+            write(S.event, &one, sizeof(one));
+        }
+    }
+    pthread_mutex_lock(&S.lock);
+    S.eof = 1;
+    pthread_mutex_unlock(&S.lock);
+    uint64_t one = 1;
+    write(S.event, &one, sizeof(one));
+    return NULL;
+}
+
+int streamStart(int fd) {
+    S.fd = fd;
+    S.event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (S.event == -1)
+        return -1;
+    pthread_mutex_init(&S.lock, NULL);
+    if (pthread_create(&S.reader, NULL, streamReader, NULL) != 0)
+        return -1;
+    pthread_detach(S.reader);
+    editorSetStatusMessage("Reading from stdin...");
+    return S.event;
+}
+
+int streamHandle(void) {
+    if (S.consumed == S.taken_len) {
+        // Swap buffers so the reader never waits on the ingestion below.
+        // The wakeup is only cleared here: anything that arrives after the
+        // swap sets it again.
+        uint64_t n;
+        read(S.event, &n, sizeof(n));
+        pthread_mutex_lock(&S.lock);
+        char *buf = S.taken;
+        size_t cap = S.taken_cap;
+        S.taken = S.pending;
+        S.taken_len = S.len;
+        S.taken_cap = S.cap;
+        S.pending = buf;
+        S.cap = cap;
+        S.len = 0;
+        S.ended = S.eof;
+        pthread_mutex_unlock(&S.lock);
+        S.consumed = 0;
+    }
+
+    size_t len = S.taken_len - S.consumed;
+    if (len > STREAM_BATCH_BYTES)
+        len = STREAM_BATCH_BYTES;
+    if (len > 0) {
+        TRACE_BEGIN("streamHandle");
+        S.partial = editorAppendText(S.taken + S.consumed, len, S.partial);
+        TRACE_END("streamHandle");
+        S.consumed += len;
+        S.total += len;
+    }
+
+    int flags = len > 0 ? SOURCE_REDRAW : 0;
+    if (S.consumed < S.taken_len)
+        flags |= SOURCE_MORE;
+    else if (S.ended && S.fd != -1) {
+        close(S.fd);
+        S.fd = -1;
+        editorEndText(S.partial);
+        editorSetStatusMessage("Read %zu bytes from stdin", S.total);
+        flags |= SOURCE_REDRAW;
+    }
+    return flags;
+}
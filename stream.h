@@ -0,0 +1,15 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+// Streaming open (`cmd | text_editor -`): a reader thread drains the pipe
+// into memory as fast as the writer produces, and the main loop appends
+// what has arrived in batches, so the buffer can be read and scrolled while
+// the command is still running.
+
+// Starts reading `fd` and returns a descriptor that becomes readable when
+// there is new input, or -1.
+int streamStart(int fd);
+// Source handler, returns SOURCE_* flags.
+int streamHandle(void);
+
+#endif
@@ -0,0 +1,137 @@
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bracket.h"
+#include "editor.h"
+#include "gen.h"
+#include "load.h"
+#include "replace.h"
+
+// Checks bracketMatch() against a scan of the whole buffer while the buffer
+// is edited at random, so that the row summaries and the segment tree over
+// them are exercised through every kind of edit. The text is loaded in
+// chunks first, which gives the rows their summaries from the load workers.
+
+static int failures = 0;
+
+static int isCode(int hl) {
+    return hl != HL_STRING && hl != HL_COMMENT && hl != HL_MLCOMMENT;
+}
+
+// What bracketMatch() should find, by walking the rendered rows one
+// character at a time.
+static int scan(int at, int cx, int *mrow, int *mrx) {
+    static const char *pairs = "()[]{}";
+    erow *row = &E.row[at];
+    editorRowTouch(row);
+    if (cx >= row->size)
+        return 0;
+    int rx = editorRowCxToRx(row, cx);
+    char c = row->render[rx];
+    if (!isCode(row->hl[rx]) || c == '\0' || !strchr(pairs, c))
+        return 0;
+    int dir = strchr("([{", c) ? 1 : -1, depth = 0;
+    for (int r = at; r >= 0 && r < E.numrows; r += dir) {
+        row = &E.row[r];
+        editorRowTouch(row);
+        int i = r == at ? rx : dir > 0 ? 0 : row->rsize - 1;
+        for (; i >= 0 && i < row->rsize; i += dir) {
+            char d = row->render[i];
+            if (!isCode(row->hl[i]) || d == '\0' || !strchr(pairs, d))
+                continue;
+            depth += strchr("([{", d) ? dir : -dir;
+            if (depth == 0) {
+                if (strchr(pairs, c) - strchr(pairs, d) != -dir)
+                    return -1;
+                *mrow = r;
+                *mrx = i;
+                return 1;
+            }
+        }
+    }
+    return -1;
+}
+
+static void check(int n) {
+    for (int k = 0; k < n && E.numrows > 0; k++) {
+        int at = rand() % E.numrows;
+        erow *row = &E.row[at];
+        if (row->size == 0)
+            continue;
+        // start from a bracket on the row if there is one
+        int cx = rand() % row->size;
+        for (int i = 0; i < row->size && !strchr("()[]{}", row->chars[cx]);
+             i++)
+            cx = (cx + 1) % row->size;
+        int grow = -1, grx = -1, wrow = -1, wrx = -1;
+        int got = bracketMatch(at, cx, &grow, &grx);
+        int want = scan(at, cx, &wrow, &wrx);
+        if (got != want || (got == 1 && (grow != wrow || grx != wrx))) {
+            printf("bracket: row %d col %d gave %d at %d:%d, want %d at "
+                   "%d:%d\n",
+                   at, cx, got, grow, grx, want, wrow, wrx);
+            failures++;
+            return;
+        }
+    }
+}
+
+static const char *pieces[] = {
+    "int f(int a[3]) {", "}", "    x = g(a[1], {2});", "/* open (",
+    "close ) */ y(", ");", "s = \"[ not\";", "// {", "", "{", "} {",
+};
+
+int main() {
+    editorInitState(48, 160);
+    E.filename = strdup("bracket.c");
+    editorSelectSyntaxHighlight();
+    size_t len;
+    char *text = genText(pieces, sizeof(pieces) / sizeof(pieces[0]), 20000,
+                         40, &len);
+    E.load_threads = 8;
+    loadText(text, len);
+    check(2000);
+
+    for (int i = 0; i < 20000 && !failures; i++) {
+        E.cursorY = rand() % E.numrows;
+        erow *row = &E.row[E.cursorY];
+        E.cursorX = row->size ? rand() % (row->size + 1) : 0;
+        switch (rand() % 7) {
+        case 0:
+            editorInsertChar("{}()[]\"/*"[rand() % 9]);
+            break;
+        case 1:
+            editorDelChar();
+            break;
+        case 2:
+            editorInsertNewLine();
+            break;
+        case 3:
+            E.cursorX = 0;
+            editorDelChar();
+            break;
+        case 4:
+            editorDelRow(E.cursorY);
+            break;
+        case 5:
+            editorInsertRow(E.cursorY, "x = f(a[1], {2});", 17);
+            break;
+        default:
+            editorInsertChar('a');
+        }
+        if (i % 500 == 0)
+            check(50);
+    }
+    replaceAll("(", "((");
+    check(2000);
+    replaceAll("/*", "");
+    check(2000);
+
+    printf("bracket: %d rows, %s\n", E.numrows, failures ? "FAILED" : "ok");
+    return failures != 0;
+}
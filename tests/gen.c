@@ -0,0 +1,22 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "gen.h"
+
+char *genText(const char **pieces, int npieces, int lines, unsigned int seed,
+              size_t *len) {
+    size_t cap = 1 << 20, n = 0;
+    char *text = malloc(cap);
+    srand(seed);
+    for (int i = 0; i < lines; i++) {
+        const char *p = pieces[rand() % npieces];
+        size_t plen = strlen(p);
+        if (n + plen + 1 > cap)
+            text = realloc(text, cap *= 2);
+        memcpy(text + n, p, plen);
+        n += plen;
+        text[n++] = '\n';
+    }
+    *len = n;
+    return text;
+}
@@ -0,0 +1,14 @@
+#ifndef GEN_H
+#define GEN_H
+
+// Test text, made of `lines` lines that are each one of `pieces` picked at
+// random, from rand() seeded with `seed`.
+
+#include <stddef.h>
+
+// Returns the text, every line of it ending in a newline, and stores its
+// length in *len. The caller frees it.
+char *genText(const char **pieces, int npieces, int lines, unsigned int seed,
+              size_t *len);
+
+#endif
@@ -0,0 +1,153 @@
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bracket.h"
+#include "editor.h"
+#include "gen.h"
+#include "load.h"
+
+// Checks that loadText() builds the same rows whatever number of chunks it
+// cuts the text into. Comments and brackets that cross a chunk boundary are
+// only right if the fix-up pass after the workers is, and that pass never
+// runs on a machine with one core unless E.load_threads forces a split.
+
+static int failures = 0;
+
+static void fail(const char *what, int threads, int row) {
+    printf("load: %s differs at row %d with %d chunks\n", what, row, threads);
+    failures++;
+}
+
+// Source-like text where comments, strings and brackets span many lines.
+static const char *pieces[] = {
+    "int f(int a[3]) {", "}", "    x = g(a[1], {2});", "/* open (",
+    "still ] inside", "close ) */ y(", ");", "s = \"/* [ not\";",
+    "// line comment {", "", "    return (a);\r", "z = '{';\r\r",
+    "} /* c */ {", "/* one line */ [",
+};
+
+static void load(const char *text, size_t len, int threads) {
+    while (E.numrows > 0)
+        editorDelRow(E.numrows - 1);
+    E.load_threads = threads;
+    loadText(text, len);
+}
+
+typedef struct rowCopy {
+    char *chars;
+    int size, open_comment, br_close, br_open;
+} rowCopy;
+
+static rowCopy *snapshot(int *n) {
+    rowCopy *rows = malloc(sizeof(rowCopy) * E.numrows);
+    for (int i = 0; i < E.numrows; i++) {
+        erow *row = &E.row[i];
+        rows[i].chars = strdup(row->chars);
+        rows[i].size = row->size;
+        rows[i].open_comment = row->hl_open_comment;
+        rows[i].br_close = row->br_close;
+        rows[i].br_open = row->br_open;
+    }
+    *n = E.numrows;
+    return rows;
+}
+
+static void compare(rowCopy *want, int n, int threads) {
+    if (E.numrows != n) {
+        fail("row count", threads, E.numrows);
+        return;
+    }
+    for (int i = 0; i < n; i++) {
+        erow *row = &E.row[i];
+        if (row->idx != i)
+            fail("idx", threads, i);
+        else if (row->size != want[i].size ||
+                 memcmp(row->chars, want[i].chars, row->size))
+            fail("text", threads, i);
+        else if (row->hl_open_comment != want[i].open_comment)
+            fail("comment state", threads, i);
+        else if (row->br_close != want[i].br_close ||
+                 row->br_open != want[i].br_open)
+            fail("brackets", threads, i);
+        else
+            continue;
+        return;
+    }
+}
+
+// The lexer the workers use has to agree with the highlighter the rest of
+// the editor uses.
+static void checkHighlight(void) {
+    for (int i = 0; i < E.numrows; i++) {
+        erow *row = &E.row[i];
+        int open_comment = row->hl_open_comment;
+        int br_close = row->br_close, br_open = row->br_open;
+        editorRowTouch(row);
+        bracketRowUpdate(row);
+        int in_comment = i > 0 && E.row[i - 1].hl_open_comment;
+        if (editorHighlightRow(row, in_comment) != open_comment) {
+            fail("highlighted comment state", 1, i);
+            return;
+        }
+        if (row->br_close != br_close || row->br_open != br_open) {
+            fail("highlighted brackets", 1, i);
+            return;
+        }
+    }
+}
+
+int main() {
+    editorInitState(48, 160);
+    E.filename = "load.c";
+    editorSelectSyntaxHighlight();
+    size_t len;
+    char *text = genText(pieces, sizeof(pieces) / sizeof(pieces[0]), 40000,
+                         38, &len);
+    len--; // the last line has no newline
+
+    load(text, len, 1);
+    int n;
+    rowCopy *want = snapshot(&n);
+    checkHighlight();
+
+    static const int split[] = {2, 3, 7, 8, 64};
+    for (size_t i = 0; i < sizeof(split) / sizeof(split[0]); i++) {
+        load(text, len, split[i]);
+        compare(want, n, split[i]);
+    }
+
+    // appending to a buffer that already has rows
+    const char *half =
+        (const char *)memchr(text + len / 2, '\n', len - len / 2) + 1;
+    load(text, half - text, 8);
+    loadText(half, text + len - half);
+    compare(want, n, 8);
+
+    // reading a pipe or a gzip file a few bytes at a time, with '\r's cut
+    // off from their '\n's
+    while (E.numrows > 0)
+        editorDelRow(E.numrows - 1);
+    int partial = 0;
+    for (size_t at = 0; at < len; at += 7) {
+        size_t step = len - at < 7 ? len - at : 7;
+        partial = editorAppendText(text + at, step, partial);
+    }
+    editorEndText(partial);
+    if (E.numrows != n)
+        fail("appended row count", 1, E.numrows);
+    for (int i = 0; i < n && E.numrows == n; i++) {
+        if (E.row[i].size != want[i].size ||
+            memcmp(E.row[i].chars, want[i].chars, want[i].size)) {
+            fail("appended text", 1, i);
+            break;
+        }
+    }
+
+    printf("load: %d rows, %s\n", n, failures ? "FAILED" : "ok");
+    return failures != 0;
+}
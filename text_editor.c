@@ -7,7 +7,8 @@
 #include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
-#include <stdarg.h>
+#include <limits.h>
+#include <poll.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -15,149 +16,121 @@
 #include <termios.h>
 #include <time.h>
 #include <unistd.h>
-
-#define KILO_VERSION "0.0.1"
-#define KILO_TAB_STOP 8
-#define KILO_QUIT_TIMES 3
-#define CTRL_KEY(k) ((k) & 0x1f)
-#define HL_HIGHLIGHT_NUMBERS (1 << 0)
-#define HL_HIGHLIGHT_STRINGS (1 << 1)
-
-// TODO: Colorful serch results
-struct editorSyntax {
-    char *filetype;
-    char **filematch;
-    char **keywords;
-    char *single_line_comment;
-    char *multiline_comment_start;
-    char *multiline_comment_end;
-    int flags;
-};
-
-typedef struct erow {
-    int idx;
-    int size;
-    int rsize;
-    char *chars;
-    char *render;
-    unsigned char *hl;
-    int hl_open_comment;
-} erow;
-
-typedef struct editorConfig {
-    int cursorX, cursorY;
-    int screenRows;
-    int rx;
-    int screenColumns;
-    int rowoff;
-    int coloff;
-    int dirty;
-    struct termios orig_termios;
-    int numrows;
-    erow *row;
-    char *filename;
-    char statusmsg[80];
-    time_t statusmsg_time;
-    struct editorSyntax *syntax;
-} editorConfig;
-
-typedef struct abuf {
-    char *b;
-    int len;
-} abuf;
-
-enum editorKey {
-    BACKSPACE = 127,
-    DEL_KEY,
-    ARROW_LEFT = 1000,
-    ARROW_RIGHT,
-    ARROW_UP,
-    ARROW_DOWN,
-    DEL,
-    HOME,
-    END,
-    PAGE_UP,
-    PAGE_DOWN,
-};
-
-enum editorHighlight {
-    HL_NORMAL = 0,
-    HL_COMMENT,
-    HL_MLCOMMENT,
-    HL_KEYWORD1,
-    HL_KEYWORD2,
-    HL_STRING,
-    HL_NUMBER,
-    HL_MATCH
-};
-
-#define ABUF_INIT {NULL, 0}
-
-editorConfig E;
-
-char *extensions[] = {".c", ".h", ".cpp", NULL};
-char *keyword[] = {"switch",    "if",      "while",   "for",    "break",
-                   "continue",  "return",  "else",    "struct", "union",
-                   "typedef",   "static",  "enum",    "class",  "case",
-                   "int|",      "long|",   "double|", "float|", "char|",
-                   "unsigned|", "signed|", "void|",   NULL};
-struct editorSyntax HLDB[] = {
-    {"c", extensions, keyword, "//", "/*", "*/",
-     HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS},
-};
-#define HLDB_ENTRIES (sizeof(HLDB) / sizeof(HLDB[0]))
+#include <zlib.h>
+
+#include "bracket.h"
+#include "complete.h"
+#include "editor.h"
+#include "follow.h"
+#include "grep.h"
+#include "gzindex.h"
+#include "load.h"
+#include "pager.h"
+#include "replace.h"
+#include "slab.h"
+#include "stream.h"
+#include "trace.h"
 
 // FUNCTIONS
 
 void die(const char *function_name);
 void enableRawMode();
 void disableRawMode();
+void editorAddSource(int fd, int (*handler)(void));
+void editorWaitForKey();
 int editorKeyRead();
-void editorDrawRows(abuf *buffer);
-void editorDrawStatusBar(abuf *buffer);
 void editorProcessKeyPress();
+int editorPagerKeyPress(int c);
+void editorPagerScrollTo(int top);
+void editorGoToLine();
+void editorComplete(int again);
+void editorJumpToBracket();
+void editorGrep();
+void editorGrepOpen();
 void editorRefreshScreen();
 int getWindowSize(int *rows, int *columns);
 void initEditor();
 int getCursorPosition(int *rows, int *columns);
-void abAppend(abuf *buffer, const char *string, int len);
-void abFree(abuf *buffer);
 void editorMoveCursor(int key);
 void editorOpen(char *filename);
-void editorInsertRow(int at, char *str, size_t len);
-void editorScroll();
-void editorUpdateRow(erow *row);
-int editorRowCxToRx(erow *row, int cursorX);
-int editorRowRxToCx(erow *row, int rx);
-void editorSetStatusMessage(const char *fmt, ...);
-void editorDrawStatusMessage(abuf *buffer);
-void editorRowInsertChar(erow *row, int at, int c);
-void editorInsertChar(int c);
-char *editorRowsToString(int *buflen);
+void editorOpenGzip(int fd);
 void editorSave();
-void editorDelChar();
-void editorRowDelChar(erow *row, int at);
-void editorFreeRow(erow *row);
-void editorDelRow(int at);
-void editorRowAppendString(erow *row, char *s, size_t len);
-void editorInsertNewLine();
-char *editorPrompt(char *prompt, void (*callback)(char *, int));
+char *editorPrompt(char *prompt, void (*callback)(char *, int),
+                   int allow_empty);
 void editorFind();
 void editorFindCallback(char *query, int key);
-void editorUpdateSyntax(erow *row);
-int editorSyntaxToColor(int hl);
-int is_separator(int c);
-void editorSelectSyntaxHighlight();
+void editorReplace();
+size_t parseSize(const char *s);
+
+// What a follow or stream source keeps appending to the buffer, if any.
+static const char *following = NULL;
 
 int main(int argc, char *argv[]) {
+    char *filename = NULL;
+    char *trace = getenv("KILO_TRACE");
+    char *budget = getenv("KILO_CACHE_BUDGET");
+    char *index_cache = getenv("KILO_INDEX_CACHE");
+    char *load_threads = getenv("KILO_LOAD_THREADS");
+    int follow = 0;
+    int pager = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-f") || !strcmp(argv[i], "--follow"))
+            follow = 1;
+        else if (!strcmp(argv[i], "-p") || !strcmp(argv[i], "--pager"))
+            pager = 1;
+        else if (!strcmp(argv[i], "--trace") && i + 1 < argc)
+            trace = argv[++i];
+        else if (!strcmp(argv[i], "--cache-budget") && i + 1 < argc)
+            budget = argv[++i];
+        else if (!strcmp(argv[i], "--index-cache") && i + 1 < argc)
+            index_cache = argv[++i];
+        else
+            filename = argv[i];
+    }
+    if (trace && *trace && traceStart(trace) == -1)
+        die("traceStart");
+    // "-" reads the buffer from stdin, so the keyboard has to come from the
+    // controlling terminal instead
+    int stream = filename && !strcmp(filename, "-");
+    if (stream && (E.ttyfd = open("/dev/tty", O_RDWR | O_CLOEXEC)) == -1)
+        die("open /dev/tty");
+
     enableRawMode();
     initEditor();
-    if (argc >= 2) {
-        editorOpen(argv[1]);
-    }
-
-    editorSetStatusMessage(
-        "HELP: Ctrl-Q = quit | Ctrl-S = save | Ctrl-f = find");
+    if (budget)
+        E.cache_budget = parseSize(budget);
+    if (load_threads)
+        E.load_threads = atoi(load_threads);
+    if (stream) {
+        int fd = streamStart(STDIN_FILENO);
+        if (fd == -1)
+            die("streamStart");
+        editorAddSource(fd, streamHandle);
+        following = "stdin";
+    } else if (filename && follow) {
+        int fd = followStart(filename);
+        if (fd == -1)
+            die("followStart");
+        editorAddSource(fd, followHandle);
+        following = filename;
+    } else if (filename && pager) {
+        int fd = pagerOpen(filename, index_cache);
+        if (fd == -1)
+            die("pagerOpen");
+        editorAddSource(fd, pagerHandle);
+    } else if (filename) {
+        editorOpen(filename);
+    }
+
+    if (E.pager)
+        editorSetStatusMessage("HELP: Ctrl-Q = quit | Ctrl-G = go to line | "
+                               "Ctrl-P = stats");
+    else
+        editorSetStatusMessage("HELP: Ctrl-Q = quit | Ctrl-S = save | "
+                               "Ctrl-f = find | Ctrl-R = replace | "
+                               "Ctrl-G = go to line | Ctrl-N = complete | "
+                               "Ctrl-B = matching bracket | "
+                               "Ctrl-T = search files | Ctrl-P = stats");
     while (1) {
         editorRefreshScreen();
         editorProcessKeyPress();
@@ -165,7 +138,7 @@ int main(int argc, char *argv[]) {
 }
 
 void enableRawMode() {
-    if (tcgetattr(STDIN_FILENO, &E.orig_termios) == -1)
+    if (tcgetattr(E.ttyfd, &E.orig_termios) == -1)
         die("tcgetattr"); // Reads terminal attributes
     atexit(disableRawMode);
     struct termios raw = E.orig_termios;
@@ -180,12 +153,12 @@ void enableRawMode() {
     raw.c_cc[VMIN] = 0;
     raw.c_cc[VTIME] = 1;
 
-    if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) == -1)
+    if (tcsetattr(E.ttyfd, TCSAFLUSH, &raw) == -1)
         die("tcsetattr"); // sets the attributes
 }
 
 void disableRawMode() {
-    if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &E.orig_termios) == -1)
+    if (tcsetattr(E.ttyfd, TCSAFLUSH, &E.orig_termios) == -1)
         die("tcsetattr");
 } // set default attributes of the terminal
 
@@ -196,22 +169,93 @@ void die(const char *s) {
     exit(1);
 }
 
+// BACKGROUND SOURCES
+
+#define MAX_SOURCES 8
+#define SOURCE_REDRAW_INTERVAL_MS 16
+
+typedef struct editorSource {
+    int fd;
+    int (*handler)(void);
+    int more;
+} editorSource;
+
+static editorSource sources[MAX_SOURCES];
+static int nsources = 0;
+
+// Registers a file descriptor to be polled alongside the keyboard. The
+// handler is called when it becomes readable, and once right away.
+void editorAddSource(int fd, int (*handler)(void)) {
+    if (nsources == MAX_SOURCES)
+        return;
+    sources[nsources].fd = fd;
+    sources[nsources].handler = handler;
+    sources[nsources].more = 1;
+    nsources++;
+}
+
+// Services background sources until a key is available. The keyboard is
+// always checked first so a busy source cannot starve it, and redraws caused
+// by sources are coalesced to one every SOURCE_REDRAW_INTERVAL_MS.
+void editorWaitForKey() {
+    static double last_redraw = 0;
+    int redraw = 0;
+    while (1) {
+        struct pollfd fds[1 + MAX_SOURCES];
+        int more = 0;
+        fds[0].fd = E.ttyfd;
+        fds[0].events = POLLIN;
+        for (int i = 0; i < nsources; i++) {
+            fds[i + 1].fd = sources[i].fd;
+            fds[i + 1].events = POLLIN;
+            more |= sources[i].more;
+        }
+        int timeout = -1;
+        if (more) {
+            timeout = 0;
+        } else if (redraw) {
+            timeout = last_redraw + SOURCE_REDRAW_INTERVAL_MS - editorNowMs();
+            if (timeout < 0)
+                timeout = 0;
+        }
+        if (poll(fds, nsources + 1, timeout) == -1 && errno != EINTR)
+            die("poll");
+        if (fds[0].revents)
+            break;
+        for (int i = 0; i < nsources; i++) {
+            if (fds[i + 1].revents || sources[i].more) {
+                int r = sources[i].handler();
+                sources[i].more = (r & SOURCE_MORE) != 0;
+                redraw |= r & SOURCE_REDRAW;
+            }
+        }
+        if (redraw &&
+            editorNowMs() - last_redraw >= SOURCE_REDRAW_INTERVAL_MS) {
+            editorRefreshScreen();
+            last_redraw = editorNowMs();
+            redraw = 0;
+        }
+    }
+    // a pending redraw is covered by the refresh after the key is handled
+}
+
 int editorKeyRead() {
     char c;
     int nread;
-    while ((nread = read(STDIN_FILENO, &c, 1) != 1)) {
+    editorWaitForKey();
+    while ((nread = read(E.ttyfd, &c, 1) != 1)) {
         if (nread == -1 && errno != EAGAIN)
             die("read");
     }
     if (c == '\x1b') {
         char seq[3];
-        if (read(STDIN_FILENO, &seq[0], 1) != 1)
+        if (read(E.ttyfd, &seq[0], 1) != 1)
             return '\x1b';
-        if (read(STDIN_FILENO, &seq[1], 1) != 1)
+        if (read(E.ttyfd, &seq[1], 1) != 1)
             return '\x1b';
         if (seq[0] == '[') {
             if (seq[1] >= '0' && seq[1] <= '9')
-                if (read(STDIN_FILENO, &seq[2], 1) != 1)
+                if (read(E.ttyfd, &seq[2], 1) != 1)
                     return '\x1b';
             if (seq[2] == '~')
                 switch (seq[1]) {
@@ -261,11 +305,20 @@ int editorKeyRead() {
 }
 void editorProcessKeyPress() {
     static int quit_times = KILO_QUIT_TIMES;
+    static int prev_key;
     int c = editorKeyRead();
+    TRACE_BEGIN("editorProcessKeyPress");
+    if (E.pager && editorPagerKeyPress(c)) {
+        TRACE_END("editorProcessKeyPress");
+        return;
+    }
 
     switch (c) {
     case '\r':
-        editorInsertNewLine();
+        if (grepShown())
+            editorGrepOpen();
+        else
+            editorInsertNewLine();
         break;
     case DEL_KEY:
     case BACKSPACE:
@@ -280,6 +333,7 @@ void editorProcessKeyPress() {
                 "WARNING!!! File is unsaved use Ctrl-Q: %d times to quit",
                 quit_times);
             quit_times--;
+            TRACE_END("editorProcessKeyPress");
             return;
         }
         write(STDOUT_FILENO, "\x1b[2J", 4);
@@ -304,8 +358,8 @@ void editorProcessKeyPress() {
         if (c == PAGE_UP) {
             E.cursorY = E.rowoff;
         } else if (c == PAGE_DOWN) {
-            E.cursorY = E.rowoff + E.screenColumns - 1;
-            if (E.cursorY < E.numrows)
+            E.cursorY = E.rowoff + E.screenRows - 1;
+            if (E.cursorY > E.numrows)
                 E.cursorY = E.numrows;
         }
         int times = E.screenRows;
@@ -322,23 +376,253 @@ void editorProcessKeyPress() {
     case CTRL('f'):
         editorFind();
         break;
+    case CTRL('r'):
+        editorReplace();
+        break;
+    case CTRL('p'):
+        E.hud = !E.hud;
+        break;
+    case CTRL('g'):
+        editorGoToLine();
+        break;
+    case CTRL('n'):
+        editorComplete(prev_key == CTRL('n'));
+        break;
+    case CTRL('b'):
+        editorJumpToBracket();
+        break;
+    case CTRL('t'):
+        editorGrep();
+        break;
     default:
         editorInsertChar(c);
         break;
     }
     quit_times = KILO_QUIT_TIMES;
+    prev_key = c;
+    TRACE_END("editorProcessKeyPress");
+}
+
+// In pager mode the movement keys scroll the view and anything that would
+// change the buffer is refused. Returns 0 for the keys that work the same as
+// in the editor.
+int editorPagerKeyPress(int c) {
+    int top = E.rowoff;
+    switch (c) {
+    case CTRL_KEY('q'):
+    case CTRL('p'):
+    case CTRL('g'):
+    case CTRL('l'):
+    case '\x1b':
+        return 0;
+    case ARROW_UP:
+        top--;
+        break;
+    case ARROW_DOWN:
+        top++;
+        break;
+    case PAGE_UP:
+        top -= E.screenRows;
+        break;
+    case PAGE_DOWN:
+        top += E.screenRows;
+        break;
+    case HOME:
+        top = 0;
+        break;
+    case END:
+        top = INT_MAX - E.screenRows;
+        break;
+    case ARROW_LEFT:
+        if (E.coloff > 0)
+            E.coloff--;
+        return 1;
+    case ARROW_RIGHT:
+        E.coloff++;
+        return 1;
+    default:
+        editorSetStatusMessage("%s is open read-only", E.filename);
+        return 1;
+    }
+    editorPagerScrollTo(top);
+    E.cursorY = E.rowoff;
+    return 1;
+}
+
+// Puts line `top` at the top of the pager view, or shows the last screenful
+// when the file ends before the screen is full.
+void editorPagerScrollTo(int top) {
+    if (top < 0)
+        top = 0;
+    int last = pagerSeekLine(top + E.screenRows - 1);
+    if (top > last - E.screenRows + 1)
+        top = last - E.screenRows + 1;
+    E.rowoff = top < 0 ? 0 : top;
+}
+
+void editorGoToLine() {
+    char *s = editorPrompt("Go to line: %s (ESC to cancel)", NULL, 0);
+    if (s == NULL)
+        return;
+    int line = atoi(s) - 1;
+    free(s);
+    if (line < 0)
+        line = 0;
+    if (E.pager) {
+        E.cursorY = pagerSeekLine(line);
+        editorPagerScrollTo(E.cursorY);
+    } else {
+        E.cursorY = line < E.numrows ? line : E.numrows;
+        E.cursorX = 0;
+        E.rowoff = E.cursorY;
+    }
+}
+
+// Completes the word before the cursor with a word from the buffer. When
+// `again` is set, i.e. Ctrl-N was the last key too, the completion inserted
+// then is swapped for the next candidate.
+void editorComplete(int again) {
+    static char prefix[COMPLETE_MAX_WORD + 1];
+    static int plen, pick, added;
+    if (E.cursorY >= E.numrows)
+        return;
+    if (again && added) {
+        while (added--)
+            editorDelChar();
+        pick++;
+    } else {
+        erow *row = &E.row[E.cursorY];
+        int x = E.cursorX;
+        while (x > 0 && (isalnum((unsigned char)row->chars[x - 1]) ||
+                         row->chars[x - 1] == '_'))
+            x--;
+        plen = E.cursorX - x;
+        if (plen == 0 || plen > COMPLETE_MAX_WORD ||
+            isdigit((unsigned char)row->chars[x])) {
+            editorSetStatusMessage("No word before the cursor");
+            added = 0;
+            return;
+        }
+        memcpy(prefix, &row->chars[x], plen);
+        prefix[plen] = '\0';
+        pick = 0;
+    }
+    const char *words[16];
+    double start = editorNowMs();
+    int n = completeLookup(prefix, plen, words, 16);
+    double us = (editorNowMs() - start) * 1000;
+    added = 0;
+    if (n == 0) {
+        editorSetStatusMessage("No completions for %s", prefix);
+        return;
+    }
+    pick %= n;
+    // inserting it re-indexes the row, which can drop the word
+    char word[COMPLETE_MAX_WORD + 1];
+    strcpy(word, words[pick]);
+    for (const char *p = word + plen; *p; p++, added++)
+        editorInsertChar(*p);
+    editorSetStatusMessage("%s (%d of %d%s, %.0fus)", word, pick + 1, n,
+                           n == 16 ? "+" : "", us);
+}
+
+void editorJumpToBracket() {
+    int row, rx;
+    int found = bracketMatch(E.cursorY, E.cursorX, &row, &rx);
+    if (found == 0) {
+        editorSetStatusMessage("No bracket under the cursor");
+    } else if (found < 0) {
+        editorSetStatusMessage("Unmatched bracket");
+    } else {
+        E.cursorY = row;
+        E.cursorX = editorRowRxToCx(&E.row[row], rx);
+    }
+}
+
+// Searches the files under the current directory and shows the matches
+// instead of the buffer.
+void editorGrep() {
+    // the followed text would end up among the results
+    if (following) {
+        editorSetStatusMessage("Can't search files while following %s",
+                               following);
+        return;
+    }
+    if (E.dirty) {
+        editorSetStatusMessage("Unsaved changes, save them first (Ctrl-S)");
+        return;
+    }
+    char *query =
+        editorPrompt("Search files for: %s (ESC to cancel)", NULL, 0);
+    if (query == NULL)
+        return;
+    static int registered = 0;
+    grepClose();
+    editorResetBuffer();
+    int fd = grepStart(query, ".");
+    if (fd == -1) {
+        editorSetStatusMessage("Can't search for %s", query);
+    } else {
+        if (!registered)
+            editorAddSource(fd, grepHandle);
+        registered = 1;
+        editorSetStatusMessage("Searching for %s...", query);
+    }
+    free(query);
+}
+
+// Opens the file and line of the result under the cursor.
+void editorGrepOpen() {
+    int line;
+    char *filename = grepResultAt(E.cursorY, &line);
+    if (filename == NULL)
+        return;
+    if (following) {
+        editorSetStatusMessage("Can't open %s while following %s", filename,
+                               following);
+        free(filename);
+        return;
+    }
+    if (access(filename, R_OK) == -1) {
+        editorSetStatusMessage("Can't open %s", filename);
+        free(filename);
+        return;
+    }
+    grepClose();
+    editorResetBuffer();
+    editorOpen(filename);
+    free(filename);
+    E.cursorY = line - 1 < E.numrows ? line - 1 : E.numrows;
+    E.rowoff = E.cursorY > E.screenRows / 2 ? E.cursorY - E.screenRows / 2 : 0;
 }
 
 void editorOpen(char *filename) {
+    TRACE_BEGIN("editorOpen");
     free(E.filename);
     E.filename = strdup(filename);
     editorSelectSyntaxHighlight();
-    FILE *fp = fopen(filename, "r");
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1)
+        die("open");
+    if (gzindexIsGzip(fd)) {
+        editorOpenGzip(fd);
+        TRACE_END("editorOpen");
+        return;
+    }
+    if (loadFile(fd) == 0) {
+        close(fd);
+        E.dirty = 0;
+        TRACE_END("editorOpen");
+        return;
+    }
+    // not a regular file, read it line by line
+    FILE *fp = fdopen(fd, "r");
     if (!fp)
-        die("fopen");
+        die("fdopen");
     char *line = NULL;
     size_t linecap = 0;
     ssize_t linelen;
+    slabArenaBegin();
     while ((linelen = getline(&line, &linecap, fp)) != -1) {
         if (linelen != -1) {
             while (linelen > 0 &&
@@ -347,13 +631,37 @@ void editorOpen(char *filename) {
             editorInsertRow(E.numrows, line, linelen);
         }
     }
+    slabArenaEnd();
     free(line);
     fclose(fp);
     E.dirty = 0;
+    TRACE_END("editorOpen");
+}
+
+#define GZIP_CHUNK (1 << 20)
+
+// Inflates a gzip file straight into rows a chunk at a time, so nothing is
+// decompressed to disk first. Saving compresses the file again.
+void editorOpenGzip(int fd) {
+    gzFile gz = gzdopen(fd, "rb");
+    if (gz == NULL)
+        die("gzdopen");
+    char *buf = malloc(GZIP_CHUNK);
+    int n, partial = 0;
+    while ((n = gzread(gz, buf, GZIP_CHUNK)) > 0)
+        partial = editorAppendText(buf, n, partial);
+    editorEndText(partial);
+    free(buf);
+    gzclose(gz);
+    E.gzip = 1;
+    E.dirty = 0;
 }
 
 void editorRefreshScreen() {
+    TRACE_BEGIN("editorRefreshScreen");
+    double start = editorNowMs();
     editorScroll();
+    bracketUpdateMatch();
     abuf buffer = ABUF_INIT;
     char buf[32];
 
@@ -366,77 +674,11 @@ void editorRefreshScreen() {
              (E.rx - E.coloff) + 1);
     abAppend(&buffer, buf, strlen(buf));
     abAppend(&buffer, "\x1b[?25h", 6);
+    editorStatsFrame(editorNowMs() - start, buffer.len);
     write(STDOUT_FILENO, buffer.b, buffer.len);
     abFree(&buffer);
+    TRACE_END("editorRefreshScreen");
 }
-void editorDrawRows(abuf *buffer) {
-    for (int i = 0; i < E.screenRows; i++) {
-        int filerow = i + E.rowoff;
-        if (filerow >= E.numrows) {
-            if (E.numrows == 0 && i == E.screenRows / 3) {
-                char welcome[80];
-                int welcomelen =
-                    snprintf(welcome, sizeof(welcome),
-                             "Kilo Editor -- version %s", KILO_VERSION);
-                if (welcomelen > E.screenColumns)
-                    welcomelen = E.screenColumns;
-                int padding = (E.screenColumns - welcomelen) / 2;
-                if (padding) {
-                    abAppend(buffer, "~", 1);
-                    padding--;
-                }
-                while (padding--)
-                    abAppend(buffer, " ", 1);
-                abAppend(buffer, welcome, welcomelen);
-            } else {
-                abAppend(buffer, "~", 1);
-            }
-        } else {
-            int len = E.row[filerow].rsize - E.coloff;
-            if (len < 0)
-                len = 0;
-            if (len > E.screenColumns)
-                len = E.screenColumns;
-            char *c = &E.row[filerow].render[E.coloff];
-            unsigned char *hl = &E.row[filerow].hl[E.coloff];
-            int current_color = -1;
-            for (int i = 0; i < len; i++) {
-                if (iscntrl(c[i])) {
-                    char sym = (c[i] <= 26) ? '@' + c[i] : '?';
-                    abAppend(buffer, "\x1b[7m", 4);
-                    abAppend(buffer, &sym, 1);
-                    abAppend(buffer, "\x1b[m", 3);
-                    if (current_color != -1) {
-                        char buf[16];
-                        int clen = snprintf(buf, sizeof(buf), "\x1b[%dm",
-                                            current_color);
-                        abAppend(buffer, buf, clen);
-                    }
-                } else if (hl[i] == HL_NORMAL) {
-                    if (current_color != -1) {
-                        abAppend(buffer, "\x1b[39m", 5);
-                        current_color = -1;
-                    }
-                    abAppend(buffer, &c[i], 1);
-                } else {
-                    int color = editorSyntaxToColor(hl[i]);
-                    if (color != current_color) {
-                        current_color = color;
-                        char buf[32];
-                        int clen =
-                            snprintf(buf, sizeof(buf), "\x1b[%dm", color);
-                        abAppend(buffer, buf, clen);
-                    }
-                    abAppend(buffer, &c[i], 1);
-                }
-            }
-            abAppend(buffer, "\x1b[39m", 5);
-        }
-        abAppend(buffer, "\x1b[K", 3);
-        abAppend(buffer, "\r\n", 2);
-    }
-}
-
 int getWindowSize(int *rows, int *column) {
     struct winsize w;
     if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &w) == -1 || w.ws_col == 0) {
@@ -452,22 +694,10 @@ int getWindowSize(int *rows, int *column) {
 }
 
 void initEditor() {
-    E.cursorX = 0;
-    E.cursorY = 0;
-    E.rx = 0;
-    E.rowoff = 0;
-    E.coloff = 0;
-    E.numrows = 0;
-    E.row = NULL;
-    E.dirty = 0;
-    E.filename = NULL;
-    E.statusmsg[0] = '\0';
-    E.statusmsg_time = 0;
-    E.syntax = NULL;
-
-    if (getWindowSize(&E.screenRows, &E.screenColumns) == -1)
+    int rows, columns;
+    if (getWindowSize(&rows, &columns) == -1)
         die("getWindowSize");
-    E.screenRows -= 2;
+    editorInitState(rows - 2, columns);
 }
 
 int getCursorPosition(int *rows, int *columns) {
@@ -478,7 +708,7 @@ int getCursorPosition(int *rows, int *columns) {
     printf("\r\n");
     char c;
     while (i < sizeof(buf) - 1) {
-        if (read(STDIN_FILENO, &c, 1) != 1)
+        if (read(E.ttyfd, &c, 1) != 1)
             break;
         if (buf[i] == 'R')
             break;
@@ -492,16 +722,6 @@ int getCursorPosition(int *rows, int *columns) {
     return 0;
 }
 
-void abAppend(abuf *buffer, const char *string, int len) {
-    char *new = realloc(buffer->b, buffer->len + len);
-    if (new == NULL)
-        return;
-    memcpy(&new[buffer->len], string, len);
-    buffer->b = new;
-    buffer->len += len;
-}
-void abFree(abuf *buffer) { free(buffer->b); }
-
 void editorMoveCursor(int key) {
     erow *row = (E.cursorY >= E.numrows) ? NULL : &E.row[E.cursorY];
     switch (key) {
@@ -535,166 +755,46 @@ void editorMoveCursor(int key) {
     if (E.cursorX > rowlen)
         E.cursorX = rowlen;
 }
-void editorInsertRow(int at, char *str, size_t len) {
-    if (at < 0 || E.numrows < at)
-        return;
-
-    E.row = realloc(E.row, sizeof(erow) * (E.numrows + 1));
-    memmove(&E.row[at + 1], &E.row[at], sizeof(erow) * (E.numrows - at));
-    for (int j = at + 1; j <= E.numrows; j++)
-        E.row[j].idx++;
-
-    E.row[at].idx = at;
-    E.row[at].size = len;
-    E.row[at].chars = malloc(len + 1);
-    memcpy(E.row[at].chars, str, len);
-    E.row[at].chars[len] = '\0';
-    E.row[at].rsize = 0;
-    E.row[at].render = NULL;
-    E.row[at].hl = NULL;
-    E.row[at].hl_open_comment = 0;
-    editorUpdateRow(&E.row[at]);
-    E.numrows++;
-    E.dirty++;
-}
-
-void editorScroll() {
-    E.rx = 0;
-    if (E.cursorY < E.numrows)
-        E.rx = editorRowCxToRx(&E.row[E.cursorY], E.cursorX);
-    if (E.rx < E.coloff) {
-        E.coloff = E.rx;
-    }
-    if (E.cursorY < E.rowoff) {
-        E.rowoff = E.cursorY;
-    }
-    if (E.rx >= E.coloff + E.screenColumns) {
-        E.coloff = E.rx - E.screenColumns + 1;
-    }
-    if (E.cursorY >= E.rowoff + E.screenRows) {
-        E.rowoff = E.cursorY - E.screenRows + 1;
-    }
-}
-void editorUpdateRow(erow *row) {
-    int tabs = 0;
-    for (int j = 0; j < row->size; j++) {
-        if (row->chars[j] == '\t')
-            tabs++;
-    }
-    free(row->render);
-    row->render = malloc(row->size + tabs * (KILO_TAB_STOP - 1) + 1);
-    int idx = 0;
-    for (int j = 0; j < row->size; j++) {
-        if (row->chars[j] == '\t') {
-            row->render[idx++] = ' ';
-            while (idx % KILO_TAB_STOP != 0)
-                row->render[idx++] = ' ';
-        } else
-            row->render[idx++] = row->chars[j];
-    }
-    row->render[idx] = '\0';
-    row->rsize = idx;
-    editorUpdateSyntax(row);
-}
-
-int editorRowCxToRx(erow *row, int cursorX) {
-    int rx = 0;
-    for (int j = 0; j < cursorX; j++) {
-        if (row->chars[j] == '\t')
-            rx += (KILO_TAB_STOP - 1) - (rx % KILO_TAB_STOP);
-        rx++;
-    }
-    return rx;
-}
-
-void editorDrawStatusBar(abuf *buffer) {
-    abAppend(buffer, "\x1b[7m", 4);
-    char status[80], rstatus[80];
-    int rlen = snprintf(rstatus, sizeof(rstatus), "%s | %d/%d",
-                        E.syntax ? E.syntax->filetype : "no ft", E.cursorY + 1,
-                        E.numrows);
-    int len = snprintf(status, sizeof(status), "%.20s - %d Lines %s",
-                       E.filename ? E.filename : "[No Name]", E.numrows,
-                       E.dirty ? "(modified)" : " ");
-    if (len > E.screenColumns)
-        len = E.screenColumns;
-    abAppend(buffer, status, len);
-    while (len < E.screenColumns) {
-        if (E.screenColumns - len == rlen) {
-            abAppend(buffer, rstatus, rlen);
-            break;
-        } else {
-            abAppend(buffer, " ", 1);
-            len++;
-        }
-    }
-    abAppend(buffer, "\x1b[m", 3);
-    abAppend(buffer, "\r\n", 2);
-}
-
-void editorSetStatusMessage(const char *fmt, ...) {
-    va_list ap;
-    va_start(ap, fmt);
-    vsnprintf(E.statusmsg, sizeof(E.statusmsg), fmt, ap);
-    va_end(ap);
-    E.statusmsg_time = time(NULL);
-}
-
-void editorDrawStatusMessage(abuf *buffer) {
-    abAppend(buffer, "\x1b[K", 3);
-    int msglen = strlen(E.statusmsg);
-    if (msglen > E.screenColumns)
-        msglen = E.screenColumns;
-    if (msglen && time(NULL) - E.statusmsg_time < 5)
-        abAppend(buffer, E.statusmsg, msglen);
-}
-
-void editorRowInsertChar(erow *row, int at, int c) {
-    if (at < 0 || at > row->size)
-        at = row->size;
-    row->chars = realloc(row->chars, row->size + 2);
-    memmove(&row->chars[at + 1], &row->chars[at], row->size - at + 1);
-    row->size++;
-    row->chars[at] = c;
-    editorUpdateRow(row);
-    E.dirty++;
-}
-
-void editorInsertChar(int c) {
-    if (E.cursorY == E.numrows) {
-        editorInsertRow(E.numrows, "", 0);
-    }
-    editorRowInsertChar(&E.row[E.cursorY], E.cursorX, c);
-    E.cursorX++;
-}
-
-char *editorRowsToString(int *buflen) {
-    int totlen = 0;
-    for (int i = 0; i < E.numrows; i++) {
-        totlen += E.row[i].size + 1;
-    }
-    *buflen = totlen;
-    char *buf = malloc(totlen);
-    char *p = buf;
-    for (int i = 0; i < E.numrows; i++) {
-        memcpy(p, E.row[i].chars, E.row[i].size);
-        p += E.row[i].size;
-        *p = '\n';
-        p++;
-    }
-    return buf;
-}
 void editorSave() {
     if (E.filename == NULL) {
-        E.filename = editorPrompt("Save as: %s", NULL);
+        E.filename = editorPrompt("Save as: %s", NULL, 0);
         if (E.filename == NULL) {
             editorSetStatusMessage("Save aborted");
             return;
         }
         editorSelectSyntaxHighlight();
     }
+    TRACE_BEGIN("editorSave");
     int len;
     char *buf = editorRowsToString(&len);
+    if (E.gzip) {
+        // errno means nothing once zlib and free() have run, so the reason
+        // is kept as soon as something fails
+        char reason[80] = "";
+        gzFile gz = gzopen(E.filename, "wb");
+        if (gz == NULL) {
+            snprintf(reason, sizeof(reason), "%s", strerror(errno));
+        } else {
+            int err;
+            if (gzwrite(gz, buf, len) != len) {
+                const char *msg = gzerror(gz, &err);
+                snprintf(reason, sizeof(reason), "%s",
+                         err == Z_ERRNO ? strerror(errno) : msg);
+            }
+            if ((err = gzclose(gz)) != Z_OK && reason[0] == '\0')
+                snprintf(reason, sizeof(reason), "%s",
+                         err == Z_ERRNO ? strerror(errno) : zError(err));
+        }
+        free(buf);
+        if (reason[0] == '\0') {
+            E.dirty = 0;
+            editorSetStatusMessage("%d bytes written on disk (gzip)", len);
+        } else {
+            editorSetStatusMessage("Can't save! %s", reason);
+        }
+        TRACE_END("editorSave");
+        return;
+    }
     int fd = open(E.filename, O_RDWR | O_CREAT, 0644);
     if (fd != -1) {
         if (ftruncate(fd, len) != -1) {
@@ -703,6 +803,7 @@ void editorSave() {
                 free(buf);
                 E.dirty = 0;
                 editorSetStatusMessage("%d bytes written on disk", len);
+                TRACE_END("editorSave");
                 return;
             }
         }
@@ -710,74 +811,13 @@ void editorSave() {
     }
     free(buf);
     editorSetStatusMessage("Cant save! I/O error", strerror(errno));
+    TRACE_END("editorSave");
 }
 
-void editorDelChar() {
-    if (E.cursorY == E.numrows)
-        return;
-    if (E.cursorX == 0 && E.cursorY == 0)
-        return;
-    erow *row = &E.row[E.cursorY];
-    if (E.cursorX > 0) {
-        editorRowDelChar(row, E.cursorX - 1);
-        E.cursorX--;
-    } else {
-        E.cursorX = E.row[E.cursorY - 1].size;
-        editorRowAppendString(&E.row[E.cursorY - 1], row->chars, row->size);
-        editorDelRow(E.cursorY);
-        E.cursorY--;
-    }
-}
-void editorRowDelChar(erow *row, int at) {
-    if (at < 0 || at > E.row->size)
-        return;
-    memmove(&row->chars[at], &row->chars[at + 1], row->size - at);
-    row->size--;
-    editorUpdateRow(row);
-    E.dirty++;
-}
-
-void editorFreeRow(erow *row) {
-    free(row->chars);
-    free(row->render);
-    free(row->hl);
-}
-void editorDelRow(int at) {
-    if (at < 0 || at >= E.numrows)
-        return;
-    editorFreeRow(&E.row[at]);
-    memmove(&E.row[at], &E.row[at + 1], sizeof(erow) * (E.numrows - at - 1));
-    for (int i = at; i < E.numrows - 1; i++) {
-        E.row[i].idx--;
-    }
-    E.numrows--;
-    E.dirty++;
-}
-void editorRowAppendString(erow *row, char *s, size_t len) {
-    row->chars = realloc(row->chars, row->size + len + 1);
-    memcpy(&row->chars[row->size], s, len);
-    row->size += len;
-    row->chars[row->size] = '\0';
-    editorUpdateRow(row);
-    E.dirty++;
-}
-void editorInsertNewLine() {
-    if (E.cursorX == 0) {
-        editorInsertRow(E.cursorY, "", 0);
-    } else {
-        erow *row = &E.row[E.cursorY];
-        editorInsertRow(E.cursorY + 1, &row->chars[E.cursorX],
-                        row->size - E.cursorX);
-        row = &E.row[E.cursorY];
-        row->size = E.cursorX;
-        row->chars[row->size] = '\0';
-        editorUpdateRow(row);
-    }
-    E.cursorY++;
-    E.cursorX = 0;
-}
-
-char *editorPrompt(char *prompt, void (*callback)(char *, int)) {
+// Reads a line on the status bar. Enter only takes an empty answer when
+// `allow_empty` is set.
+char *editorPrompt(char *prompt, void (*callback)(char *, int),
+                   int allow_empty) {
     size_t bufsize = 128;
     char *buf = malloc(bufsize);
     size_t buflen = 0;
@@ -796,7 +836,7 @@ char *editorPrompt(char *prompt, void (*callback)(char *, int)) {
             free(buf);
             return NULL;
         } else if (c == '\r') {
-            if (buflen != 0) {
+            if (buflen != 0 || allow_empty) {
                 editorSetStatusMessage("");
                 if (callback)
                     callback(buf, c);
@@ -821,7 +861,9 @@ void editorFindCallback(char *query, int key) {
     static int saved_hl_line;
     static char *saved_hl = NULL;
     if (saved_hl) {
-        memcpy(E.row[saved_hl_line].hl, saved_hl, E.row[saved_hl_line].rsize);
+        if (E.row[saved_hl_line].hl)
+            memcpy(E.row[saved_hl_line].hl, saved_hl,
+                   E.row[saved_hl_line].rsize);
         free(saved_hl);
         saved_hl = NULL;
     }
@@ -839,27 +881,22 @@ void editorFindCallback(char *query, int key) {
     }
     if (last_match == -1)
         direction = 1;
-    int current = last_match;
-    for (int i = 0; i < E.numrows; i++) {
-        current += direction;
-        if (current == -1)
-            current = E.numrows - 1;
-        else if (current == E.numrows)
-            current = 0;
+    TRACE_BEGIN("editorFindCallback");
+    int offset;
+    int current = editorFindNext(query, last_match, direction, &offset);
+    if (current != -1) {
         erow *row = &E.row[current];
-        char *match = strstr(row->chars, query);
-        if (match) {
-            last_match = current;
-            E.cursorY = current;
-            E.cursorX = editorRowRxToCx(row, match - row->render);
-            E.rowoff = E.numrows;
-            saved_hl_line = current;
-            saved_hl = malloc(row->rsize);
-            memcpy(saved_hl, row->hl, row->rsize);
-            memset(&row->hl[match - row->render], HL_MATCH, strlen(query));
-            break;
-        }
+        editorRowTouch(row);
+        last_match = current;
+        E.cursorY = current;
+        E.cursorX = editorRowRxToCx(row, offset);
+        E.rowoff = E.numrows;
+        saved_hl_line = current;
+        saved_hl = malloc(row->rsize);
+        memcpy(saved_hl, row->hl, row->rsize);
+        memset(&row->hl[offset], HL_MATCH, strlen(query));
     }
+    TRACE_END("editorFindCallback");
 }
 
 void editorFind() {
@@ -868,7 +905,7 @@ void editorFind() {
     int saved_coloff = E.coloff;
     int saved_rowoff = E.rowoff;
     char *query =
-        editorPrompt("Find: %s (Use ESC/Arrows/Enter)", editorFindCallback);
+        editorPrompt("Find: %s (Use ESC/Arrows/Enter)", editorFindCallback, 0);
     if (query)
         free(query);
     else {
@@ -879,165 +916,35 @@ void editorFind() {
     }
 }
 
-int editorRowRxToCx(erow *row, int rx) {
-    int cur_rx = 0;
-    int cursorX;
-    for (cursorX = 0; cursorX < row->size; cursorX++) {
-        if (row->chars[cursorX] == '\t')
-            cur_rx += (KILO_TAB_STOP - 1) - (cur_rx % KILO_TAB_STOP);
-        cur_rx++;
-        if (cur_rx > rx)
-            return cursorX;
-    }
-    return cursorX;
-}
-
-void editorUpdateSyntax(erow *row) {
-    row->hl = realloc(row->hl, row->rsize);
-    memset(row->hl, HL_NORMAL, row->rsize);
-    if (E.syntax == NULL)
+void editorReplace() {
+    char *query = editorPrompt("Replace: %s (ESC to cancel)", NULL, 0);
+    if (!query)
         return;
-    char **keywords = E.syntax->keywords;
-    char *scs = E.syntax->single_line_comment;
-    char *mcs = E.syntax->multiline_comment_end;
-    char *mce = E.syntax->multiline_comment_start;
-    int scs_len = scs ? strlen(scs) : 0;
-    int mcs_len = mcs ? strlen(mcs) : 0;
-    int mce_len = mcs ? strlen(mce) : 0;
-    int prev_sep = 1;
-    int in_string = 0;
-    int in_comment = (row->idx > 0 && E.row[row->idx - 1].hl_open_comment);
-    int i = 0;
-    while (i < row->rsize) {
-        char c = row->render[i];
-        unsigned char prev_hl = (i > 0) ? row->hl[i - 1] : HL_NORMAL;
-        if (scs_len && !in_string && !in_comment) {
-            if (!strncmp(&row->render[i], scs, scs_len)) {
-                memset(&row->hl[i], HL_COMMENT, row->size - i);
-                break;
-            }
-        }
-        if (mcs_len && mce_len && !in_string) {
-            if (in_comment) {
-                row->hl[i] = HL_COMMENT;
-                if (!strncmp(&row->render[i], mce, mce_len)) {
-                    memset(&row->hl[i], HL_MLCOMMENT, mce_len);
-                    i += mce_len;
-                    in_comment = 0;
-                    prev_sep = 1;
-                    continue;
-                } else {
-                    i++;
-                    continue;
-                }
-            } else if (!strncmp(&row->render[i], mcs, mcs_len)) {
-                memset(&row->hl[i], HL_MLCOMMENT, mcs_len);
-                i += mcs_len;
-                in_comment = 1;
-                continue;
-            }
-        }
-        if (E.syntax->flags & HL_HIGHLIGHT_STRINGS) {
-            if (in_string) {
-                row->hl[i] = HL_STRING;
-                if (c == '\\' && i + 1 < row->size) {
-                    row->hl[i + 1] = HL_STRING;
-                    i += 2;
-                    continue;
-                }
-                if (c == in_string)
-                    in_string = 0;
-                i++;
-                prev_sep = 1;
-                continue;
-            } else {
-                if (c == '"' || c == '\'') {
-                    in_string = c;
-                    row->hl[i] = HL_STRING;
-                    i++;
-                    continue;
-                }
-            }
-        }
-        if (E.syntax->flags & HL_HIGHLIGHT_NUMBERS) {
-            if ((isdigit(c) && (prev_sep || prev_hl == HL_NUMBER)) ||
-                (c == '.' && prev_hl == HL_NUMBER)) {
-                row->hl[i] = HL_NUMBER;
-                i++;
-                prev_sep = 0;
-                continue;
-            }
-        }
-        if (prev_sep) {
-            int j;
-            for (j = 0; keywords[j]; j++) {
-                int klen = strlen(keywords[j]);
-                int kw2 = keywords[j][klen - 1] == '|';
-                if (kw2)
-                    klen--;
-                if (!strncmp(&row->render[i], keywords[j], klen) &&
-                    is_separator(row->render[i + klen])) {
-                    memset(&row->hl[i], kw2 ? HL_KEYWORD2 : HL_KEYWORD1, klen);
-                    i += klen;
-                    break;
-                }
-            }
-            if (keywords[j] != NULL) {
-                prev_sep = 0;
-                continue;
-            }
-        }
-        prev_sep = is_separator(c);
-        i++;
-    }
-    int changed = (row->hl_open_comment != in_comment);
-    row->hl_open_comment = in_comment;
-    if (changed && row->idx + 1 < E.numrows)
-        editorUpdateSyntax(&E.row[row->idx + 1]);
-}
-
-int editorSyntaxToColor(int hl) {
-    switch (hl) {
-    case HL_KEYWORD1:
-        return 33;
-    case HL_KEYWORD2:
-        return 32;
-    case HL_MLCOMMENT:
-    case HL_COMMENT:
-        return 36;
-    case HL_NUMBER:
-        return 34;
-    case HL_STRING:
-        return 35;
-    case HL_MATCH:
-        return 31;
-    default:
-        return 37;
-    };
-}
-
-int is_separator(int c) {
-    return isspace(c) || c == '\0' || strchr(",.()+-/*=~%<>[];", c) == NULL;
-}
-
-void editorSelectSyntaxHighlight() {
-    E.syntax = NULL;
-    if (E.filename == NULL)
+    char *with = editorPrompt("Replace with: %s (ESC to cancel, empty deletes)",
+                              NULL, 1);
+    if (!with) {
+        free(query);
         return;
-    char *ext = strchr(E.filename, '.');
-    for (unsigned int i = 0; i < HLDB_ENTRIES; i++) {
-        struct editorSyntax *s = &HLDB[i];
-        unsigned int j = 0;
-        while (s->filematch[j]) {
-            int is_ext = (s->filematch[i][0] == '.');
-            if ((is_ext && ext && !strcmp(ext, s->filematch[j])) ||
-                (!is_ext && strstr(E.filename, s->filematch[j]))) {
-                E.syntax = s;
-                for (int filerow = 0; filerow < E.numrows; filerow++) {
-                    editorUpdateSyntax(&E.row[filerow]);
-                }
-                return;
-            }
-        }
     }
+    double start = editorNowMs();
+    long count = replaceAll(query, with);
+    editorSetStatusMessage("Replaced %ld occurrences in %.0fms", count,
+                           editorNowMs() - start);
+    free(query);
+    free(with);
+}
+
+// Parses a byte count with an optional K, M or G suffix, e.g. "512M".
+size_t parseSize(const char *s) {
+    char *end;
+    size_t size = strtoull(s, &end, 10);
+    switch (toupper((unsigned char)*end)) {
+    case 'G':
+        size <<= 10; // fall through
+    case 'M':
+        size <<= 10; // fall through
+    case 'K':
+        size <<= 10;
+    }
+    return size;
 }
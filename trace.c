@@ -0,0 +1,154 @@
+#define _DEFAULT_SOURCE
+#define _BSD_SOURCE
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+#define TRACE_RING_SIZE (1 << 16)
+#define TRACE_RING_MASK (TRACE_RING_SIZE - 1)
+#define TRACE_FLUSH_INTERVAL_NS 10000000
+
+// Bounded multi-producer ring (Vyukov style): a producer claims a position by
+// bumping head, fills the slot and publishes it through the slot's sequence
+// number. The flusher is the only consumer. When the ring is full the event
+// is dropped and counted instead of blocking the traced thread.
+typedef struct traceSlot {
+    unsigned long seq;
+    const char *name;
+    char phase;
+    int tid;
+    double ts;
+} traceSlot;
+
+typedef struct traceState {
+    traceSlot *ring;
+    unsigned long head;
+    unsigned long tail;
+    unsigned long dropped;
+    int running;
+    int events;
+    FILE *fp;
+    pthread_t flusher;
+} traceState;
+
+int trace_enabled = 0;
+static traceState T;
+static __thread int trace_tid;
+
+static double traceNowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+void traceEvent(const char *name, char phase) {
+    double ts = traceNowUs();
+    if (!trace_tid)
+        trace_tid = syscall(SYS_gettid);
+    unsigned long pos = __atomic_load_n(&T.head, __ATOMIC_RELAXED);
+    for (;;) {
+        traceSlot *slot = &T.ring[pos & TRACE_RING_MASK];
+        unsigned long seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        long diff = (long)(seq - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&T.head, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+                slot->name = name;
+                slot->phase = phase;
+                slot->tid = trace_tid;
+                slot->ts = ts;
+                __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+                return;
+            }
+        } else if (diff < 0) {
+            __atomic_add_fetch(&T.dropped, 1, __ATOMIC_RELAXED);
+            return;
+        } else {
+            pos = __atomic_load_n(&T.head, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// Writes every published event to the file and returns how many there were.
+static int traceDrain() {
+    int n = 0;
+    for (;;) {
+        traceSlot *slot = &T.ring[T.tail & TRACE_RING_MASK];
+        unsigned long seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (seq != T.tail + 1)
+            break;
+        fprintf(T.fp,
+                "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,"
+                "\"tid\":%d}",
+                T.events++ ? ",\n" : "", slot->name, slot->phase, slot->ts,
+                (int)getpid(), slot->tid);
+        __atomic_store_n(&slot->seq, T.tail + TRACE_RING_SIZE,
+                         __ATOMIC_RELEASE);
+        T.tail++;
+        n++;
+    }
+    return n;
+}
+
+static void *traceFlusher(void *arg) {
+    (void)arg;
+    struct timespec interval = {0, TRACE_FLUSH_INTERVAL_NS};
+    while (__atomic_load_n(&T.running, __ATOMIC_ACQUIRE)) {
+        if (traceDrain() == 0) {
+            fflush(T.fp);
+            nanosleep(&interval, NULL);
+        }
+    }
+    return NULL;
+}
+
+int traceStart(const char *path) {
+    if (__atomic_load_n(&trace_enabled, __ATOMIC_RELAXED))
+        return 0;
+    T.fp = fopen(path, "w");
+    if (!T.fp)
+        return -1;
+    if (T.ring == NULL)
+        T.ring = malloc(sizeof(traceSlot) * TRACE_RING_SIZE);
+    for (unsigned long i = 0; i < TRACE_RING_SIZE; i++)
+        T.ring[i].seq = i;
+    T.head = T.tail = T.dropped = 0;
+    T.events = 0;
+    T.running = 1;
+    fputs("[\n", T.fp);
+    if (pthread_create(&T.flusher, NULL, traceFlusher, NULL) != 0) {
+        fclose(T.fp);
+        return -1;
+    }
+    __atomic_store_n(&trace_enabled, 1, __ATOMIC_RELAXED);
+    atexit(traceStop);
+    return 0;
+}
+
+// Runs at exit, when threads like the pager indexer or grep workers may still
+// be tracing. One that got past the check on trace_enabled can still write
+// to the ring, so the ring is never freed; its events are simply not drained.
+void traceStop() {
+    if (!__atomic_load_n(&trace_enabled, __ATOMIC_RELAXED))
+        return;
+    __atomic_store_n(&trace_enabled, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&T.running, 0, __ATOMIC_RELEASE);
+    pthread_join(T.flusher, NULL);
+    traceDrain();
+    if (T.dropped)
+        fprintf(T.fp,
+                "%s{\"name\":\"trace_dropped\",\"ph\":\"C\",\"ts\":%.3f,"
+                "\"pid\":%d,\"tid\":%d,\"args\":{\"events\":%lu}}",
+                T.events ? ",\n" : "", traceNowUs(), (int)getpid(),
+                trace_tid, T.dropped);
+    fputs("\n]\n", T.fp);
+    fclose(T.fp);
+}
@@ -0,0 +1,28 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+// Opt-in event tracing in Chrome trace JSON format (load the file in
+// chrome://tracing or Perfetto). Events go into a lock-free ring buffer and
+// a background thread writes them out, so the traced code never touches the
+// file. When tracing is off, TRACE_BEGIN/TRACE_END are a single branch on
+// trace_enabled, which background threads read too.
+
+extern int trace_enabled;
+
+#define TRACE_BEGIN(name)                                                      \
+    do {                                                                       \
+        if (__atomic_load_n(&trace_enabled, __ATOMIC_RELAXED))                 \
+            traceEvent(name, 'B');                                             \
+    } while (0)
+#define TRACE_END(name)                                                        \
+    do {                                                                       \
+        if (__atomic_load_n(&trace_enabled, __ATOMIC_RELAXED))                 \
+            traceEvent(name, 'E');                                             \
+    } while (0)
+
+// `name` must outlive the trace, in practice a string literal.
+void traceEvent(const char *name, char phase);
+int traceStart(const char *path);
+void traceStop();
+
+#endif